@@ -0,0 +1,125 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_handle.h>
+#include <learnopengl/gpu_timer.h>
+#include <learnopengl/render_target.h>
+#include <learnopengl/shader.h>
+
+#include <vector>
+using namespace std;
+
+// levels of the bloom mip chain, the first at half the output size, each next one halved again
+const unsigned int BLOOM_LEVELS = 6;
+
+// GPU time of every pass of the last measured frame, in milliseconds
+struct BloomStats {
+    float downsampleMs[BLOOM_LEVELS] = {};      // into level i
+    float upsampleMs[BLOOM_LEVELS] = {};        // into level i from level i + 1, the last one unused
+    float totalMs = 0.0f;
+};
+
+// bloom as a progressive mip chain: the bright color of the scene is downsampled level by level with a 13 tap
+// filter, then upsampled back with a tent filter, each level added onto the next larger one. every pass reads
+// and writes at most half the output resolution, in a packed float format, and the wide blur comes from the
+// small levels instead of wide kernels.
+class Bloom
+{
+public:
+    // downsampleShader and upsampleShader are bloom.vs with bloom_downsample.fs and bloom_upsample.fs;
+    // the levels are added to targets, so they follow the output size and the render scale. needs a current context
+    Bloom(RenderTargets &targets, Shader &downsampleShader, Shader &upsampleShader)
+        : downsample(&downsampleShader), upsample(&upsampleShader)
+    {
+        for(unsigned int level = 0; level < BLOOM_LEVELS; level++)
+            levels.push_back(&targets.Add({ GL_R11F_G11F_B10F }, false, true, level + 1));
+        // the fullscreen triangle has no attributes, but the core profile still wants a VAO bound to draw
+        emptyVao = VertexArrayHandle::Create();
+
+        downsampleUvScale = downsample->Uniform("sourceUvScale");
+        downsampleFirstLevel = downsample->Uniform("firstLevel");
+        upsampleUvScale = upsample->Uniform("sourceUvScale");
+        upsampleRadius = upsample->Uniform("radius");
+        downsample->use();
+        downsample->setInt("source", 0);
+        upsample->use();
+        upsample->setInt("source", 0);
+    }
+
+    Bloom(const Bloom&) = delete;
+    Bloom& operator=(const Bloom&) = delete;
+
+    // blurs source, a texture whose lower left sourceUvScale part holds the bright color of the scene.
+    // radius spreads the upsampling filter, in texels of each level. leaves the last level's framebuffer
+    // bound, blending enabled with the alpha blend function and texture unit 0 active.
+    void Render(GLuint source, const glm::vec2 &sourceUvScale, float radius)
+    {
+        glBindVertexArray(emptyVao.Get());
+        glActiveTexture(GL_TEXTURE0);
+        glDisable(GL_BLEND);
+
+        downsample->use();
+        GLuint input = source;
+        glm::vec2 inputUvScale = sourceUvScale;
+        for(unsigned int level = 0; level < BLOOM_LEVELS; level++)
+        {
+            timers[level].Begin();
+            levels[level]->Bind();
+            downsample->setInt(downsampleFirstLevel, level == 0);
+            downsample->setVec2(downsampleUvScale, inputUvScale);
+            glBindTexture(GL_TEXTURE_2D, input);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            timers[level].End();
+            input = levels[level]->Color(0);
+            inputUvScale = levels[level]->UvScale();
+        }
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        upsample->use();
+        upsample->setFloat(upsampleRadius, radius);
+        for(unsigned int level = BLOOM_LEVELS - 1; level-- > 0;)
+        {
+            timers[BLOOM_LEVELS + level].Begin();
+            levels[level]->Bind();
+            upsample->setVec2(upsampleUvScale, levels[level + 1]->UvScale());
+            glBindTexture(GL_TEXTURE_2D, levels[level + 1]->Color(0));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            timers[BLOOM_LEVELS + level].End();
+        }
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glBindVertexArray(0);
+
+        // pick up whatever finished of the earlier frames
+        bool updated = false;
+        for(GpuTimer &timer : timers)
+            updated = timer.Poll() || updated;
+        if(updated)
+        {
+            stats.totalMs = 0.0f;
+            for(unsigned int level = 0; level < BLOOM_LEVELS; level++)
+            {
+                stats.downsampleMs[level] = timers[level].Milliseconds();
+                stats.upsampleMs[level] = timers[BLOOM_LEVELS + level].Milliseconds();
+                stats.totalMs += stats.downsampleMs[level] + stats.upsampleMs[level];
+            }
+        }
+    }
+
+    // the blurred bright color, in the lower left UvScale part of the texture
+    GLuint Result() const { return levels[0]->Color(0); }
+    glm::vec2 UvScale() const { return levels[0]->UvScale(); }
+
+    BloomStats stats;
+
+private:
+    Shader *downsample, *upsample;
+    UniformHandle downsampleUvScale, downsampleFirstLevel, upsampleUvScale, upsampleRadius;
+    vector<RenderTarget*> levels;
+    VertexArrayHandle emptyVao;
+    GpuTimer timers[2 * BLOOM_LEVELS];  // downsample passes, then upsample passes
+};
+#endif
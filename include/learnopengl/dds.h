@@ -0,0 +1,151 @@
+#ifndef DDS_H
+#define DDS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// S3TC enums are an extension on top of the 3.3 core profile glad was generated for
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// minimal DDS container support: 2D BC1 (DXT1) and BC3 (DXT5) images with a full mip chain,
+// which is exactly what tools/texture_baker writes.
+struct DDSPixelFormat {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t rgbBitCount;
+    uint32_t rBitMask;
+    uint32_t gBitMask;
+    uint32_t bBitMask;
+    uint32_t aBitMask;
+};
+
+struct DDSHeader {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitchOrLinearSize;
+    uint32_t depth;
+    uint32_t mipMapCount;
+    uint32_t reserved1[11];
+    DDSPixelFormat pixelFormat;
+    uint32_t caps;
+    uint32_t caps2;
+    uint32_t caps3;
+    uint32_t caps4;
+    uint32_t reserved2;
+};
+
+const uint32_t DDS_MAGIC       = 0x20534444; // "DDS "
+const uint32_t DDS_FOURCC_DXT1 = 0x31545844; // "DXT1"
+const uint32_t DDS_FOURCC_DXT5 = 0x35545844; // "DXT5"
+
+// larger than any texture GL_MAX_TEXTURE_SIZE allows, so a header claiming more is garbage
+const uint32_t DDS_MAX_DIMENSION = 16384;
+
+struct DDSLevel {
+    size_t offset;      // into DDSImage::data
+    size_t size;
+    int width;
+    int height;
+};
+
+struct DDSImage {
+    unsigned int format = 0;    // GL_COMPRESSED_*_S3TC_*
+    vector<unsigned char> data; // all levels back to back, largest first
+    vector<DDSLevel> levels;
+};
+
+// bytes of one 4x4 block for the given compressed format
+inline size_t DDSBlockSize(unsigned int format)
+{
+    return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16;
+}
+
+inline size_t DDSLevelSize(unsigned int format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * DDSBlockSize(format);
+}
+
+inline bool ReadDDS(const string &path, DDSImage &image)
+{
+    ifstream in(path, ios::binary | ios::ate);
+    if(!in)
+        return false;
+    const streamoff fileSize = in.tellg();
+    in.seekg(0);
+    uint32_t magic = 0;
+    DDSHeader header;
+    in.read((char*)&magic, sizeof(magic));
+    in.read((char*)&header, sizeof(header));
+    if(!in || magic != DDS_MAGIC || header.size != sizeof(DDSHeader))
+        return false;
+
+    if(header.pixelFormat.fourCC == DDS_FOURCC_DXT1)
+        image.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    else if(header.pixelFormat.fourCC == DDS_FOURCC_DXT5)
+        image.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    else
+        return false;
+
+    // a stale or corrupt header must neither make us allocate whatever it says nor loop over bogus levels
+    if(header.width == 0 || header.height == 0 || header.width > DDS_MAX_DIMENSION || header.height > DDS_MAX_DIMENSION)
+        return false;
+    unsigned int maxLevels = 1;
+    for(uint32_t size = max(header.width, header.height); size > 1; size /= 2)
+        maxLevels++;
+    unsigned int levelCount = header.mipMapCount > 0 ? min(header.mipMapCount, maxLevels) : 1;
+    int width = (int)header.width;
+    int height = (int)header.height;
+    size_t total = 0;
+    image.levels.clear();
+    for(unsigned int level = 0; level < levelCount; level++)
+    {
+        DDSLevel info = { total, DDSLevelSize(image.format, width, height), width, height };
+        image.levels.push_back(info);
+        total += info.size;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    if((streamoff)total > fileSize - (streamoff)(sizeof(magic) + sizeof(header)))
+        return false;
+    image.data.resize(total);
+    in.read((char*)image.data.data(), total);
+    return (bool)in;
+}
+
+inline bool WriteDDS(const string &path, const DDSImage &image)
+{
+    if(image.levels.empty())
+        return false;
+    DDSHeader header;
+    memset(&header, 0, sizeof(header));
+    header.size = sizeof(DDSHeader);
+    header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // caps, height, width, pixel format, mip count, linear size
+    header.width = (uint32_t)image.levels[0].width;
+    header.height = (uint32_t)image.levels[0].height;
+    header.pitchOrLinearSize = (uint32_t)image.levels[0].size;
+    header.mipMapCount = (uint32_t)image.levels.size();
+    header.pixelFormat.size = sizeof(DDSPixelFormat);
+    header.pixelFormat.flags = 0x4; // fourCC
+    header.pixelFormat.fourCC = image.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? DDS_FOURCC_DXT1 : DDS_FOURCC_DXT5;
+    header.caps = 0x1000 | 0x400000 | 0x8; // texture, mipmap, complex
+
+    ofstream out(path, ios::binary | ios::trunc);
+    out.write((const char*)&DDS_MAGIC, sizeof(DDS_MAGIC));
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)image.data.data(), image.data.size());
+    return (bool)out;
+}
+#endif
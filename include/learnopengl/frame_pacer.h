@@ -0,0 +1,125 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+using namespace std;
+
+// how frames are presented
+enum PresentMode {
+    PRESENT_VSYNC = 0,  // swap interval 1, waits for every vertical blank
+    PRESENT_ADAPTIVE,   // swap interval -1: vsync, but late frames tear instead of waiting a whole refresh
+    PRESENT_UNCAPPED,   // swap interval 0, as fast as possible
+    PRESENT_LIMITED,    // swap interval 0, the CPU waits for the target frame time before swapping
+    PRESENT_MODE_COUNT
+};
+
+const char *const PRESENT_MODE_NAMES[PRESENT_MODE_COUNT] = { "Vsync", "Adaptive vsync", "Uncapped", "Frame limiter" };
+
+const unsigned int FRAME_PACER_HISTORY = 240;   // frame times kept for the graph and the variance
+const unsigned int FRAME_PACER_SMOOTHING = 8;   // frames averaged into the smoothed delta
+const float FRAME_PACER_MAX_DELTA = 0.1f;       // longer frames (hitches, window drags) count as this long
+// the limiter sleeps until this much before the deadline and spins the rest; sleeps overshoot by up to a
+// scheduler tick, spinning is exact
+const double FRAME_PACER_SPIN_SECONDS = 0.002;
+
+// frame timing: presentation mode, an optional CPU frame limiter and smoothed frame times.
+// per frame: BeginFrame at the top of the loop, Wait right before glfwSwapBuffers.
+class FramePacer
+{
+public:
+    FramePacer() : lastFrameStart(clock::now())
+    {
+        for(unsigned int i = 0; i < FRAME_PACER_HISTORY; i++)
+            history[i] = 0.0f;
+    }
+
+    // applies the swap interval when the mode changes; needs a current context. adaptive vsync falls back
+    // to plain vsync where the driver lacks the swap control tear extension.
+    void SetMode(PresentMode presentMode, float targetFps)
+    {
+        targetFrameSeconds = targetFps > 0.0f ? 1.0 / targetFps : 0.0;
+        if(presentMode == mode)
+            return;
+        mode = presentMode;
+        int interval = 0;
+        if(mode == PRESENT_VSYNC)
+            interval = 1;
+        else if(mode == PRESENT_ADAPTIVE)
+            interval = glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear") ? -1 : 1;
+        glfwSwapInterval(interval);
+    }
+
+    PresentMode Mode() const { return mode; }
+
+    // measures the frame that just ended and returns the smoothed frame time in seconds, the one to move
+    // things with; the raw time is in RawDelta
+    float BeginFrame()
+    {
+        const clock::time_point now = clock::now();
+        rawDelta = chrono::duration<float>(now - lastFrameStart).count();
+        lastFrameStart = now;
+
+        const float delta = min(rawDelta, FRAME_PACER_MAX_DELTA);
+        history[historyNext] = delta * 1000.0f;
+        historyNext = (historyNext + 1) % FRAME_PACER_HISTORY;
+        historySize = min(historySize + 1, FRAME_PACER_HISTORY);
+
+        const unsigned int samples = min(historySize, FRAME_PACER_SMOOTHING);
+        float sum = 0.0f;
+        for(unsigned int i = 1; i <= samples; i++)
+            sum += history[(historyNext + FRAME_PACER_HISTORY - i) % FRAME_PACER_HISTORY];
+        smoothedDelta = sum / samples / 1000.0f;
+        return smoothedDelta;
+    }
+
+    // with the frame limiter, blocks until the target frame time has passed since BeginFrame
+    void Wait()
+    {
+        if(mode != PRESENT_LIMITED || targetFrameSeconds <= 0.0)
+            return;
+        const clock::time_point deadline = lastFrameStart + chrono::duration_cast<clock::duration>(chrono::duration<double>(targetFrameSeconds));
+        const clock::duration spin = chrono::duration_cast<clock::duration>(chrono::duration<double>(FRAME_PACER_SPIN_SECONDS));
+        if(clock::now() < deadline - spin)
+            this_thread::sleep_until(deadline - spin);
+        while(clock::now() < deadline)
+            this_thread::yield();
+    }
+
+    float RawDelta() const { return rawDelta; }
+    float SmoothedDelta() const { return smoothedDelta; }
+
+    // frame times in milliseconds, oldest first from HistoryOffset on (for ImGui::PlotLines' values_offset)
+    const float *History() const { return history; }
+    unsigned int HistoryOffset() const { return historySize < FRAME_PACER_HISTORY ? 0 : historyNext; }
+    unsigned int HistorySize() const { return historySize; }
+
+    // mean and variance of the frame times in the history, in milliseconds and milliseconds squared
+    void Statistics(float &mean, float &variance) const
+    {
+        mean = variance = 0.0f;
+        if(historySize == 0)
+            return;
+        for(unsigned int i = 0; i < historySize; i++)
+            mean += history[i];
+        mean /= historySize;
+        for(unsigned int i = 0; i < historySize; i++)
+            variance += (history[i] - mean) * (history[i] - mean);
+        variance /= historySize;
+    }
+
+private:
+    typedef chrono::steady_clock clock;
+
+    PresentMode mode = PRESENT_MODE_COUNT;  // nothing applied yet
+    double targetFrameSeconds = 0.0;
+    clock::time_point lastFrameStart;
+    float rawDelta = 0.0f, smoothedDelta = 0.0f;
+    float history[FRAME_PACER_HISTORY];
+    unsigned int historyNext = 0, historySize = 0;
+};
+#endif
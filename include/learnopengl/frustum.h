@@ -0,0 +1,184 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_SSE 1
+#endif
+
+// bounds of a piece of geometry in its own space: an axis aligned box (center, half extents) and a sphere
+// around the same center. both are tested, whichever is tighter for a given orientation decides.
+struct BoundingVolume {
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 extents = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    // Vertex-like types with a Position
+    template<typename PositionVertex>
+    static BoundingVolume FromVertices(const PositionVertex *vertices, size_t count)
+    {
+        BoundingVolume volume;
+        if(count == 0)
+            return volume;
+        glm::vec3 low = vertices[0].Position, high = low;
+        for(size_t i = 1; i < count; i++)
+        {
+            const glm::vec3 &p = vertices[i].Position;
+            low = glm::vec3(min(low.x, p.x), min(low.y, p.y), min(low.z, p.z));
+            high = glm::vec3(max(high.x, p.x), max(high.y, p.y), max(high.z, p.z));
+        }
+        volume.center = (low + high) * 0.5f;
+        volume.extents = (high - low) * 0.5f;
+        float radiusSquared = 0.0f;
+        for(size_t i = 0; i < count; i++)
+        {
+            const glm::vec3 d = vertices[i].Position - volume.center;
+            radiusSquared = max(radiusSquared, glm::dot(d, d));
+        }
+        volume.radius = sqrt(radiusSquared);
+        return volume;
+    }
+
+    // the volume after a model transform: the box becomes the axis aligned box around the transformed box
+    // (Arvo), the sphere grows by the largest axis scale
+    BoundingVolume Transformed(const glm::mat4 &model) const
+    {
+        const glm::vec3 axis[3] = { glm::vec3(model[0]), glm::vec3(model[1]), glm::vec3(model[2]) };
+        BoundingVolume volume;
+        volume.center = glm::vec3(model * glm::vec4(center, 1.0f));
+        volume.extents.x = fabs(axis[0].x) * extents.x + fabs(axis[1].x) * extents.y + fabs(axis[2].x) * extents.z;
+        volume.extents.y = fabs(axis[0].y) * extents.x + fabs(axis[1].y) * extents.y + fabs(axis[2].y) * extents.z;
+        volume.extents.z = fabs(axis[0].z) * extents.x + fabs(axis[1].z) * extents.y + fabs(axis[2].z) * extents.z;
+        const float scale = sqrt(max(glm::dot(axis[0], axis[0]), max(glm::dot(axis[1], axis[1]), glm::dot(axis[2], axis[2]))));
+        volume.radius = radius * scale;
+        return volume;
+    }
+};
+
+// the six planes of a projection * view matrix (Gribb/Hartmann), normalized and pointing inwards.
+// stored as structure of arrays for the batch test.
+struct Frustum {
+    float nx[6], ny[6], nz[6], d[6];
+
+    static Frustum FromMatrix(const glm::mat4 &viewProjection)
+    {
+        // rows of the (column major) matrix
+        glm::vec4 row[4];
+        for(int i = 0; i < 4; i++)
+            row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        const glm::vec4 planes[6] = {
+            row[3] + row[0], row[3] - row[0],   // left, right
+            row[3] + row[1], row[3] - row[1],   // bottom, top
+            row[3] + row[2], row[3] - row[2]    // near, far
+        };
+        Frustum frustum;
+        for(int i = 0; i < 6; i++)
+        {
+            const float length = sqrt(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
+            const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+            frustum.nx[i] = planes[i].x * scale;
+            frustum.ny[i] = planes[i].y * scale;
+            frustum.nz[i] = planes[i].z * scale;
+            frustum.d[i] = planes[i].w * scale;
+        }
+        return frustum;
+    }
+};
+
+// batch frustum test. volumes are added already transformed to world space and kept as structure of
+// arrays, Cull then tests four at a time against all planes with SSE (scalar where SSE is not available).
+class FrustumCuller
+{
+public:
+    void Clear()
+    {
+        count = 0;
+        cx.clear(); cy.clear(); cz.clear();
+        ex.clear(); ey.clear(); ez.clear();
+        radius.clear();
+    }
+
+    // adds a model space volume with its model matrix, returns the index to query Visible with
+    unsigned int Add(const BoundingVolume &volume, const glm::mat4 &model)
+    {
+        const BoundingVolume world = volume.Transformed(model);
+        cx.push_back(world.center.x);
+        cy.push_back(world.center.y);
+        cz.push_back(world.center.z);
+        ex.push_back(world.extents.x);
+        ey.push_back(world.extents.y);
+        ez.push_back(world.extents.z);
+        radius.push_back(world.radius);
+        return count++;
+    }
+
+    // tests everything added since Clear, returns how many volumes are visible
+    unsigned int Cull(const Frustum &frustum)
+    {
+        // pad to a multiple of four; the padding is never queried
+        const unsigned int padded = (count + 3) & ~3u;
+        for(vector<float> *lane : { &cx, &cy, &cz, &ex, &ey, &ez, &radius })
+            lane->resize(padded, 0.0f);
+        visible.assign(padded, 0);
+
+        unsigned int visibleCount = 0;
+#ifdef FRUSTUM_SSE
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        for(unsigned int i = 0; i < padded; i += 4)
+        {
+            const __m128 x = _mm_loadu_ps(&cx[i]), y = _mm_loadu_ps(&cy[i]), z = _mm_loadu_ps(&cz[i]);
+            const __m128 hx = _mm_loadu_ps(&ex[i]), hy = _mm_loadu_ps(&ey[i]), hz = _mm_loadu_ps(&ez[i]);
+            const __m128 r = _mm_loadu_ps(&radius[i]);
+            __m128 outside = zero;
+            for(int p = 0; p < 6; p++)
+            {
+                const __m128 px = _mm_set1_ps(frustum.nx[p]), py = _mm_set1_ps(frustum.ny[p]), pz = _mm_set1_ps(frustum.nz[p]);
+                const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, x), _mm_mul_ps(py, y)),
+                                                   _mm_add_ps(_mm_mul_ps(pz, z), _mm_set1_ps(frustum.d[p])));
+                // projected half size of the box onto the plane normal
+                const __m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, px), hx),
+                                                               _mm_mul_ps(_mm_andnot_ps(signMask, py), hy)),
+                                                    _mm_mul_ps(_mm_andnot_ps(signMask, pz), hz));
+                const __m128 boxOutside = _mm_cmplt_ps(_mm_add_ps(distance, boxRadius), zero);
+                const __m128 sphereOutside = _mm_cmplt_ps(_mm_add_ps(distance, r), zero);
+                outside = _mm_or_ps(outside, _mm_or_ps(boxOutside, sphereOutside));
+            }
+            const int mask = _mm_movemask_ps(outside);
+            for(unsigned int lane = 0; lane < 4; lane++)
+                visible[i + lane] = (mask & (1 << lane)) ? 0 : 1;
+        }
+#else
+        for(unsigned int i = 0; i < padded; i++)
+        {
+            bool outside = false;
+            for(int p = 0; p < 6 && !outside; p++)
+            {
+                const float distance = frustum.nx[p] * cx[i] + frustum.ny[p] * cy[i] + frustum.nz[p] * cz[i] + frustum.d[p];
+                const float boxRadius = fabs(frustum.nx[p]) * ex[i] + fabs(frustum.ny[p]) * ey[i] + fabs(frustum.nz[p]) * ez[i];
+                outside = distance + boxRadius < 0.0f || distance + radius[i] < 0.0f;
+            }
+            visible[i] = outside ? 0 : 1;
+        }
+#endif
+        for(unsigned int i = 0; i < count; i++)
+            visibleCount += visible[i];
+        return visibleCount;
+    }
+
+    bool Visible(unsigned int index) const { return visible[index] != 0; }
+    unsigned int Size() const { return count; }
+
+private:
+    unsigned int count = 0;
+    vector<float> cx, cy, cz, ex, ey, ez, radius;
+    vector<unsigned char> visible;
+};
+#endif
@@ -0,0 +1,171 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_handle.h>
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+using namespace std;
+
+// default size of a page, larger meshes get a page of their own size
+const size_t GEOMETRY_PAGE_VERTEX_BYTES = 16 << 20;
+const size_t GEOMETRY_PAGE_INDEX_BYTES  = 8 << 20;
+
+// one vertex and one index buffer shared by all meshes of the same vertex layout and index type, with a
+// single VAO describing them. meshes are bump allocated and addressed through base vertex / first index;
+// a page is reused from the start once every allocation in it has been freed.
+struct GeometryPage {
+    VertexLayout layout;
+    GLenum indexType;
+    VertexArrayHandle vao;
+    BufferHandle vertexBuffer, indexBuffer;
+    unsigned int vertexCapacity = 0, vertexUsed = 0;
+    unsigned int indexCapacity = 0, indexUsed = 0;
+    unsigned int liveAllocations = 0;
+    GLuint instanceBuffer = 0;      // buffer the instance attributes of the VAO point at, see Mesh::AttachInstanceBuffer
+
+    unsigned int IndexSize() const { return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int); }
+
+    // only the byte layout matters, the dequantization constants are per mesh uniforms
+    bool Holds(const VertexLayout &other, GLenum otherIndexType) const
+    {
+        return indexType == otherIndexType && layout.stride == other.stride
+            && layout.format.attributes == other.format.attributes
+            && layout.format.quantizedPositions == other.format.quantizedPositions
+            && layout.format.octahedralNormals == other.format.octahedralNormals
+            && layout.format.halfTexCoords == other.format.halfTexCoords;
+    }
+};
+
+// a mesh's range inside a page, given back to the arena when destroyed
+class GeometryAllocation
+{
+public:
+    GeometryPage *page = nullptr;
+    unsigned int baseVertex = 0;
+    unsigned int firstIndex = 0;
+
+    GeometryAllocation() {}
+    GeometryAllocation(GeometryPage *owner, unsigned int base, unsigned int first) : page(owner), baseVertex(base), firstIndex(first) {}
+    ~GeometryAllocation() { Free(); }
+
+    GeometryAllocation(const GeometryAllocation&) = delete;
+    GeometryAllocation& operator=(const GeometryAllocation&) = delete;
+
+    GeometryAllocation(GeometryAllocation &&other) noexcept : page(other.page), baseVertex(other.baseVertex), firstIndex(other.firstIndex)
+    {
+        other.page = nullptr;
+    }
+
+    GeometryAllocation& operator=(GeometryAllocation &&other) noexcept
+    {
+        if(this != &other)
+        {
+            Free();
+            page = other.page;
+            baseVertex = other.baseVertex;
+            firstIndex = other.firstIndex;
+            other.page = nullptr;
+        }
+        return *this;
+    }
+
+    explicit operator bool() const { return page != nullptr; }
+
+    void Free()
+    {
+        if(page && --page->liveAllocations == 0)
+            page->vertexUsed = page->indexUsed = 0;
+        page = nullptr;
+    }
+};
+
+// process-wide pool of geometry pages. with the arena enabled, meshes upload into shared buffers instead
+// of creating their own, so meshes of one layout share a VAO and can be drawn with a single multi-draw.
+// pages live until the end of the process, like the other singletons their GL names are then just dropped.
+class GeometryArena
+{
+public:
+    static GeometryArena &Instance()
+    {
+        static GeometryArena arena;
+        return arena;
+    }
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // affects meshes created from now on
+    void SetEnabled(bool enable) { enabled = enable; }
+    bool Enabled() const { return enabled; }
+
+    // uploads a mesh into the first page of its layout with room for it. indices are converted to the page's
+    // index type; with 16-bit pages they are relative to the base vertex, so any mesh below 65536 vertices fits.
+    GeometryAllocation Upload(const VertexLayout &layout, GLenum indexType, const void *vertexData, unsigned int vertexCount,
+                              const unsigned int *indexData, unsigned int indexCount)
+    {
+        GeometryPage *page = findPage(layout, indexType, vertexCount, indexCount);
+        GeometryAllocation allocation(page, page->vertexUsed, page->indexUsed);
+        page->vertexUsed += vertexCount;
+        page->indexUsed += indexCount;
+        page->liveAllocations++;
+
+        // the copy target leaves the element buffer binding of whatever VAO is bound alone
+        glBindBuffer(GL_COPY_WRITE_BUFFER, page->vertexBuffer.Get());
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation.baseVertex * layout.stride, (GLsizeiptr)vertexCount * layout.stride, vertexData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, page->indexBuffer.Get());
+        const GLintptr indexOffset = (GLintptr)allocation.firstIndex * page->IndexSize();
+        if(indexType == GL_UNSIGNED_SHORT)
+        {
+            vector<unsigned short> shortIndices(indexData, indexData + indexCount);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexCount * sizeof(unsigned short), shortIndices.data());
+        }
+        else
+            glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexCount * sizeof(unsigned int), indexData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return allocation;
+    }
+
+    unsigned int PageCount() const { return (unsigned int)pages.size(); }
+
+private:
+    bool enabled = false;
+    vector<unique_ptr<GeometryPage>> pages;
+
+    GeometryArena() {}
+
+    GeometryPage *findPage(const VertexLayout &layout, GLenum indexType, unsigned int vertexCount, unsigned int indexCount)
+    {
+        for(const unique_ptr<GeometryPage> &page : pages)
+        {
+            if(page->Holds(layout, indexType) && page->vertexUsed + vertexCount <= page->vertexCapacity
+               && page->indexUsed + indexCount <= page->indexCapacity)
+                return page.get();
+        }
+
+        unique_ptr<GeometryPage> page(new GeometryPage());
+        page->layout = layout;
+        page->indexType = indexType;
+        page->vertexCapacity = max((unsigned int)(GEOMETRY_PAGE_VERTEX_BYTES / layout.stride), vertexCount);
+        page->indexCapacity = max((unsigned int)(GEOMETRY_PAGE_INDEX_BYTES / page->IndexSize()), indexCount);
+
+        page->vao = VertexArrayHandle::Create();
+        page->vertexBuffer = BufferHandle::Create();
+        page->indexBuffer = BufferHandle::Create();
+        glBindVertexArray(page->vao.Get());
+        glBindBuffer(GL_ARRAY_BUFFER, page->vertexBuffer.Get());
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)page->vertexCapacity * layout.stride, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page->indexBuffer.Get());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)page->indexCapacity * page->IndexSize(), nullptr, GL_STATIC_DRAW);
+        layout.SetupAttributes();
+        glBindVertexArray(0);
+
+        pages.push_back(std::move(page));
+        return pages.back().get();
+    }
+};
+#endif
@@ -0,0 +1,149 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <string>
+#include <unordered_set>
+using namespace std;
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+#define GL_ANY_SAMPLES_PASSED_CONSERVATIVE 0x8D6A
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// glMultiDrawElementsIndirect (GL 4.3 / ARB_multi_draw_indirect), not part of the generated loader
+typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+
+// glGetProgramBinary, glProgramBinary and glProgramParameteri (GL 4.1 / ARB_get_program_binary)
+typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+// the command layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+// glad was generated for the plain 3.3 core profile, so anything beyond that is looked up here at runtime.
+// Init must be called once on the context thread after gladLoadGLLoader, with the same loader to also
+// resolve the entry points of the extensions used here.
+class GLExtensions
+{
+public:
+    static void Init(GLADloadproc load = nullptr)
+    {
+        names().clear();
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for(GLint i = 0; i < count; i++)
+            names().insert((const char*)glGetStringi(GL_EXTENSIONS, i));
+
+        multiDrawElementsIndirect() = nullptr;
+        const bool core43 = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 3);
+        if(load && (core43 || Has("GL_ARB_multi_draw_indirect")))
+            multiDrawElementsIndirect() = (MultiDrawElementsIndirectProc)load("glMultiDrawElementsIndirect");
+        conservativeOcclusion() = core43 || Has("GL_ARB_ES3_compatibility");
+
+        getProgramBinary() = nullptr;
+        programBinary() = nullptr;
+        programParameteri() = nullptr;
+        const bool core41 = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1);
+        GLint binaryFormats = 0;
+        if(core41 || Has("GL_ARB_get_program_binary"))
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+        // a driver without any binary format has the entry points but can't save anything
+        if(load && binaryFormats > 0)
+        {
+            getProgramBinary() = (GetProgramBinaryProc)load("glGetProgramBinary");
+            programBinary() = (ProgramBinaryProc)load("glProgramBinary");
+            programParameteri() = (ProgramParameteriProc)load("glProgramParameteri");
+            if(!getProgramBinary() || !programBinary() || !programParameteri())
+                getProgramBinary() = nullptr;
+        }
+    }
+
+    static bool Has(const char *name)
+    {
+        return names().count(name) > 0;
+    }
+
+    // block compressed textures as written by tools/texture_baker
+    static bool S3TC()
+    {
+        return Has("GL_EXT_texture_compression_s3tc");
+    }
+
+    // null without multi-draw indirect support, callers fall back to glMultiDrawElementsBaseVertex
+    static MultiDrawElementsIndirectProc MultiDrawElementsIndirect()
+    {
+        return multiDrawElementsIndirect();
+    }
+
+    // occlusion query target: the conservative one (GL 4.3 / ARB_ES3_compatibility) may answer with less
+    // precision but faster, plain GL_ANY_SAMPLES_PASSED otherwise
+    static GLenum OcclusionQueryTarget()
+    {
+        return conservativeOcclusion() ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED;
+    }
+
+    // program binaries can be saved and loaded; the entry points below are null otherwise
+    static bool ProgramBinaries()
+    {
+        return getProgramBinary() != nullptr;
+    }
+
+    static GetProgramBinaryProc GetProgramBinary() { return getProgramBinary(); }
+    static ProgramBinaryProc ProgramBinary() { return programBinary(); }
+    static ProgramParameteriProc ProgramParameteri() { return programParameteri(); }
+
+private:
+    static bool &conservativeOcclusion()
+    {
+        static bool supported = false;
+        return supported;
+    }
+
+    static MultiDrawElementsIndirectProc &multiDrawElementsIndirect()
+    {
+        static MultiDrawElementsIndirectProc proc = nullptr;
+        return proc;
+    }
+
+    static GetProgramBinaryProc &getProgramBinary()
+    {
+        static GetProgramBinaryProc proc = nullptr;
+        return proc;
+    }
+
+    static ProgramBinaryProc &programBinary()
+    {
+        static ProgramBinaryProc proc = nullptr;
+        return proc;
+    }
+
+    static ProgramParameteriProc &programParameteri()
+    {
+        static ProgramParameteriProc proc = nullptr;
+        return proc;
+    }
+
+    static unordered_set<string> &names()
+    {
+        static unordered_set<string> extensions;
+        return extensions;
+    }
+};
+#endif
@@ -0,0 +1,118 @@
+#ifndef GL_HANDLE_H
+#define GL_HANDLE_H
+
+#include <glad/glad.h>
+
+// whether GL objects may still be deleted. main ends the context's lifetime right before glfwTerminate;
+// handles that are destroyed later (locals of main, singletons) then only forget their names.
+class GLContextLifetime
+{
+public:
+    static bool Alive() { return alive(); }
+    static void End() { alive() = false; }
+
+private:
+    static bool &alive()
+    {
+        static bool contextAlive = true;
+        return contextAlive;
+    }
+};
+
+// move-only owner of a single GL object name. the name is deleted with the handle, so whoever holds the
+// handle (a Mesh, a Shader, a cache entry) decides when the object goes away. Traits provide Create/Destroy.
+template<typename Traits>
+class GLHandle
+{
+public:
+    GLHandle() : name(0) {}
+    explicit GLHandle(GLuint adopted) : name(adopted) {}
+    ~GLHandle() { Reset(); }
+
+    GLHandle(const GLHandle&) = delete;
+    GLHandle& operator=(const GLHandle&) = delete;
+
+    GLHandle(GLHandle &&other) noexcept : name(other.name)
+    {
+        other.name = 0;
+    }
+
+    GLHandle& operator=(GLHandle &&other) noexcept
+    {
+        if(this != &other)
+        {
+            Reset();
+            name = other.name;
+            other.name = 0;
+        }
+        return *this;
+    }
+
+    // a freshly generated object
+    static GLHandle Create() { return GLHandle(Traits::Create()); }
+
+    GLuint Get() const { return name; }
+    explicit operator bool() const { return name != 0; }
+
+    // gives up ownership without deleting
+    GLuint Release()
+    {
+        GLuint released = name;
+        name = 0;
+        return released;
+    }
+
+    void Reset(GLuint adopted = 0)
+    {
+        if(name && GLContextLifetime::Alive())
+            Traits::Destroy(name);
+        name = adopted;
+    }
+
+private:
+    GLuint name;
+};
+
+struct GLBufferTraits {
+    static GLuint Create() { GLuint name; glGenBuffers(1, &name); return name; }
+    static void Destroy(GLuint name) { glDeleteBuffers(1, &name); }
+};
+
+struct GLVertexArrayTraits {
+    static GLuint Create() { GLuint name; glGenVertexArrays(1, &name); return name; }
+    static void Destroy(GLuint name) { glDeleteVertexArrays(1, &name); }
+};
+
+struct GLTextureTraits {
+    static GLuint Create() { GLuint name; glGenTextures(1, &name); return name; }
+    static void Destroy(GLuint name) { glDeleteTextures(1, &name); }
+};
+
+struct GLProgramTraits {
+    static GLuint Create() { return glCreateProgram(); }
+    static void Destroy(GLuint name) { glDeleteProgram(name); }
+};
+
+struct GLQueryTraits {
+    static GLuint Create() { GLuint name; glGenQueries(1, &name); return name; }
+    static void Destroy(GLuint name) { glDeleteQueries(1, &name); }
+};
+
+struct GLFramebufferTraits {
+    static GLuint Create() { GLuint name; glGenFramebuffers(1, &name); return name; }
+    static void Destroy(GLuint name) { glDeleteFramebuffers(1, &name); }
+};
+
+struct GLRenderbufferTraits {
+    static GLuint Create() { GLuint name; glGenRenderbuffers(1, &name); return name; }
+    static void Destroy(GLuint name) { glDeleteRenderbuffers(1, &name); }
+};
+
+typedef GLHandle<GLBufferTraits>      BufferHandle;
+typedef GLHandle<GLVertexArrayTraits> VertexArrayHandle;
+typedef GLHandle<GLTextureTraits>     TextureHandle;
+typedef GLHandle<GLProgramTraits>     ProgramHandle;
+typedef GLHandle<GLQueryTraits>       QueryHandle;
+typedef GLHandle<GLFramebufferTraits> FramebufferHandle;
+typedef GLHandle<GLRenderbufferTraits> RenderbufferHandle;
+#endif
@@ -0,0 +1,78 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_handle.h>
+
+// frames a measurement may take to come back before its query is reused
+const unsigned int GPU_TIMER_LATENCY = 4;
+
+// GPU time of a stretch of commands, measured with a pair of GL_TIMESTAMP queries (unlike GL_TIME_ELAPSED
+// these may overlap, so timers can be nested). results are read a few frames late and only once available,
+// so measuring never stalls the CPU on the GPU.
+// per frame: Begin and End around the measured commands, Poll once.
+class GpuTimer
+{
+public:
+    void Begin()
+    {
+        if(!starts[0])
+        {
+            for(unsigned int i = 0; i < GPU_TIMER_LATENCY; i++)
+            {
+                starts[i] = QueryHandle::Create();
+                ends[i] = QueryHandle::Create();
+            }
+        }
+        // all queries still in flight: this frame goes unmeasured
+        measuring = !pending[slot];
+        if(measuring)
+            glQueryCounter(starts[slot].Get(), GL_TIMESTAMP);
+    }
+
+    void End()
+    {
+        if(!measuring)
+            return;
+        glQueryCounter(ends[slot].Get(), GL_TIMESTAMP);
+        pending[slot] = true;
+        slot = (slot + 1) % GPU_TIMER_LATENCY;
+        measuring = false;
+    }
+
+    // picks up the finished measurements, oldest first; returns whether there was a new one
+    bool Poll()
+    {
+        bool updated = false;
+        for(unsigned int i = 0; i < GPU_TIMER_LATENCY; i++)
+        {
+            const unsigned int oldest = (slot + i) % GPU_TIMER_LATENCY;
+            if(!pending[oldest])
+                continue;
+            GLint available = 0;
+            // the end is written after the start, once it is there both are
+            glGetQueryObjectiv(ends[oldest].Get(), GL_QUERY_RESULT_AVAILABLE, &available);
+            if(!available)
+                break;
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(starts[oldest].Get(), GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(ends[oldest].Get(), GL_QUERY_RESULT, &end);
+            milliseconds = (float)((end - start) / 1.0e6);
+            pending[oldest] = false;
+            updated = true;
+        }
+        return updated;
+    }
+
+    // latest finished measurement
+    float Milliseconds() const { return milliseconds; }
+
+private:
+    QueryHandle starts[GPU_TIMER_LATENCY], ends[GPU_TIMER_LATENCY];
+    bool pending[GPU_TIMER_LATENCY] = {};
+    unsigned int slot = 0;
+    bool measuring = false;
+    float milliseconds = 0.0f;
+};
+#endif
@@ -6,8 +6,13 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/frustum.h>
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/gl_handle.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/vertex_format.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 using namespace std;
@@ -27,43 +32,145 @@ struct Vertex {
 
 
 
+// index range of one level of detail inside a mesh's index buffer; level 0 is the full mesh
+struct MeshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+};
+
+// what happens to a mesh's geometry in system memory once it is on the GPU
+enum GeometryResidency {
+    GEOMETRY_GPU_ONLY,  // released right after the upload
+    GEOMETRY_KEEP_CPU   // kept in Mesh::vertices/indices for CPU side consumers (picking, collision, LOD rebuilds)
+};
+
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
+// CPU-side result of importing a mesh. it is produced without touching OpenGL, so it can be built on a
+// worker thread, and is turned into a Mesh on the context thread. the geometry is either owned (fresh
+// import) or points into a mapped mesh cache; texture ids are only known after upload.
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<Texture>      textures;
+    vector<MeshLod>      lods;      // index ranges of the levels of detail inside indices, empty for a single level
+    BoundingVolume       bounds;    // model space bounds of the vertices, for frustum culling
+    bool                 transparent = false;   // material opacity below one, drawn blended after the opaque meshes
+
+    const Vertex       *mappedVertices = nullptr;
+    const unsigned int *mappedIndices = nullptr;
+    unsigned int mappedVertexCount = 0;
+    unsigned int mappedIndexCount = 0;
+
+    // the vertices converted to a compact format, filled by Pack; empty means upload the full Vertex
+    vector<unsigned char> packedVertices;
+    VertexLayout          layout;
+
+    // quantizationBox: optional (low, high) box to quantize the positions to, see PackVertices
+    void Pack(const VertexFormat &format, const glm::vec3 *quantizationBox = nullptr)
+    {
+        if(!format.IsFull())
+            layout = PackVertices(VertexData(), VertexCount(), format, packedVertices, quantizationBox);
+    }
+
+    const Vertex *VertexData() const { return mappedVertices ? mappedVertices : vertices.data(); }
+    unsigned int VertexCount() const { return mappedVertices ? mappedVertexCount : (unsigned int)vertices.size(); }
+    const unsigned int *IndexData() const { return mappedIndices ? mappedIndices : indices.data(); }
+    unsigned int IndexCount() const { return mappedIndices ? mappedIndexCount : (unsigned int)indices.size(); }
+};
+
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data. vertices/indices are only filled for meshes created with GEOMETRY_KEEP_CPU
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
 
-    unsigned int VAO;
+    VertexArrayHandle VAO;          // empty for meshes in the geometry arena, see VertexArray()
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    GLenum indexType;               // GL_UNSIGNED_SHORT for meshes with fewer than 65536 vertices
+    VertexLayout layout;
+    vector<MeshLod> lods;           // levels of detail, all indexing the same vertices; lods[0] is the full mesh
+    BoundingVolume bounds;          // model space bounds, set by Model::Upload
+    bool transparent = false;       // queued into PASS_TRANSPARENT whatever pass the mesh is enqueued with
     std::string glslIdentifierPrefix;
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, GeometryResidency residency = GEOMETRY_GPU_ONLY)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+        if(residency == GEOMETRY_GPU_ONLY)
+            ReleaseGeometry();
+    }
+
+    // constructor for vertices already packed into the given layout (see PackVertices)
+    Mesh(const unsigned char *packedVertices, unsigned int vertexCount, const VertexLayout &layout, const unsigned int *indexData, unsigned int indexCount, vector<Texture> textures)
+    {
+        this->textures = std::move(textures);
+        this->layout = layout;
+        setupMesh(packedVertices, vertexCount, indexData, indexCount);
+    }
+
+    // constructor for geometry that already sits in memory in its final layout (e.g. a mapped mesh cache).
+    // the data is uploaded straight from the given pointers and no CPU-side copy is kept in vertices/indices.
+    Mesh(const Vertex *vertexData, unsigned int vertexCount, const unsigned int *indexData, unsigned int indexCount, vector<Texture> textures)
+    {
+        this->textures = std::move(textures);
+        setupMesh(vertexData, vertexCount, indexData, indexCount);
+    }
+
+    // a mesh owns its GL objects, so it can be moved (e.g. into Model::meshes) but not copied
+    Mesh(Mesh&&) = default;
+    Mesh& operator=(Mesh&&) = default;
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    // gives a mesh created from packed or mapped data a CPU copy of its full geometry
+    void KeepGeometry(const Vertex *vertexData, unsigned int vertexCount, const unsigned int *indexData, unsigned int indexCount)
+    {
+        vertices.assign(vertexData, vertexData + vertexCount);
+        indices.assign(indexData, indexData + indexCount);
+    }
+
+    // drops the CPU copy, the GPU buffers are unaffected
+    void ReleaseGeometry()
+    {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+    }
+
+    size_t CpuBytes() const
+    {
+        return vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int);
+    }
+
+    size_t GpuBytes() const
+    {
+        return (size_t)vertexCount * layout.stride + (size_t)indexCount * (indexType == GL_UNSIGNED_SHORT ? 2 : 4);
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // the sampler uniform each texture is bound to, by unit: prefix + type + N, where N counts the textures
+    // of that type (texture_diffuse1, texture_diffuse2, texture_specular1, ...)
+    const vector<string> &SamplerNames() const
     {
-        // bind appropriate textures
+        if(samplerNames.size() == textures.size())
+            return samplerNames;
+        samplerNames.clear();
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -75,63 +182,176 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            samplerNames.push_back(glslIdentifierPrefix + name + number);
         }
+        return samplerNames;
+    }
 
-
+    // render the mesh at the given level of detail (clamped to the levels the mesh has)
+    void Draw(Shader &shader, unsigned int lod = 0)
+    {
+        bindMaterial(shader);
 
         // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(VertexArray());
+        const MeshLod &range = lods[min(lod, (unsigned int)lods.size() - 1)];
+        glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, indexType, IndexOffset(range), BaseVertex());
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // render instanceCount copies of the mesh in one draw call. instanceBuffer holds one glm::mat4 model
+    // matrix per instance, which the shader reads at ATTRIB_INSTANCE_MODEL instead of a model uniform.
+    void DrawInstanced(Shader &shader, GLuint instanceBuffer, unsigned int instanceCount, unsigned int lod = 0)
+    {
+        bindMaterial(shader);
+
+        glBindVertexArray(VertexArray());
+        AttachInstanceBuffer(instanceBuffer);
+        const MeshLod &range = lods[min(lod, (unsigned int)lods.size() - 1)];
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, indexType, IndexOffset(range), instanceCount, BaseVertex());
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // points the per-instance model matrix of the VAO at a buffer of glm::mat4, the VAO of the mesh has to be
+    // bound. the attribute setup is part of the VAO (shared by all meshes of an arena page), so it only happens
+    // when the buffer changes.
+    void AttachInstanceBuffer(GLuint buffer) const
+    {
+        GLuint &attached = geometry ? geometry.page->instanceBuffer : instanceBuffer;
+        if(buffer == attached)
+            return;
+        attached = buffer;
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        for(unsigned int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(ATTRIB_INSTANCE_MODEL + column);
+            glVertexAttribPointer(ATTRIB_INSTANCE_MODEL + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(ATTRIB_INSTANCE_MODEL + column, 1);
+        }
+    }
+
+    // VAO the mesh is drawn with: its own, or the one of its arena page
+    GLuint VertexArray() const
+    {
+        return geometry ? geometry.page->vao.Get() : VAO.Get();
+    }
+
+    // what the indices of the mesh are relative to in its vertex buffer
+    GLint BaseVertex() const
+    {
+        return geometry ? (GLint)geometry.baseVertex : 0;
+    }
+
+    // index of the first index of a level in the element buffer
+    unsigned int FirstIndex(const MeshLod &range) const
+    {
+        return (geometry ? geometry.firstIndex : 0) + range.indexOffset;
+    }
+
+    // byte offset of a level's indices in the element buffer, as glDrawElements expects it
+    const void *IndexOffset(const MeshLod &range) const
+    {
+        const size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        return (const void*)(FirstIndex(range) * indexSize);
+    }
+
 private:
+    mutable vector<string> samplerNames;
+
+    // the dequantization uniforms of the program the mesh was last drawn with, looked up again only when
+    // it is drawn with another one
+    struct DequantizeUniforms {
+        GLuint program = 0;
+        UniformHandle positionScale;
+        UniformHandle positionOffset;
+    };
+    mutable DequantizeUniforms dequantizeUniforms;
+
+    const DequantizeUniforms &dequantizeHandles(const Shader &shader) const
+    {
+        if(dequantizeUniforms.program != shader.ID)
+        {
+            dequantizeUniforms.program = shader.ID;
+            dequantizeUniforms.positionScale = shader.Uniform("positionScale");
+            dequantizeUniforms.positionOffset = shader.Uniform("positionOffset");
+        }
+        return dequantizeUniforms;
+    }
+    mutable GLuint instanceBuffer = 0;      // buffer the instance attributes of the own VAO currently point at
+    GeometryAllocation geometry;            // range in the geometry arena, if the mesh was uploaded there
+
+    // binds the textures to units 0..n and points the samplers at them, and sets the position dequantization
+    void bindMaterial(Shader &shader)
+    {
+        const vector<string> &samplers = SamplerNames();
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+            // now set the sampler to the correct texture unit
+            shader.setInt(samplers[i], i);
+            // and finally bind the texture
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+
+        // dequantization of the positions, shaders without quantized input simply don't have these
+        const DequantizeUniforms &dequantize = dequantizeHandles(shader);
+        if(dequantize.positionScale.Valid())
+        {
+            shader.setVec3(dequantize.positionScale, layout.positionScale);
+            shader.setVec3(dequantize.positionOffset, layout.positionOffset);
+        }
+    }
+
     // render data
-    unsigned int VBO, EBO;
+    BufferHandle VBO, EBO;
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // initializes all the buffer objects/arrays. the vertices are laid out as described by layout,
+    // which is the full Vertex unless the constructor was handed packed data.
+    void setupMesh(const void *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount)
     {
+        this->vertexCount = vertexCount;
+        this->indexCount = indexCount;
+        lods.assign(1, MeshLod{ 0, (unsigned int)indexCount });
+
+        // 16-bit indices halve the index buffer whenever the vertices can be addressed with them
+        indexType = vertexCount < 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        if(GeometryArena::Instance().Enabled())
+        {
+            geometry = GeometryArena::Instance().Upload(layout, indexType, vertexData, vertexCount, indexData, indexCount);
+            return;
+        }
+
         // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        VAO = VertexArrayHandle::Create();
+        VBO = BufferHandle::Create();
+        EBO = BufferHandle::Create();
 
-        glBindVertexArray(VAO);
+        glBindVertexArray(VAO.Get());
         // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO.Get());
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * layout.stride, vertexData, GL_STATIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.Get());
+        if(indexType == GL_UNSIGNED_SHORT)
+        {
+            vector<unsigned short> shortIndices(indexData, indexData + indexCount);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+        }
+        else
+        {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
+        }
+
+        // set the vertex attribute pointers (positions, normals, texture coords, tangents, bitangents)
+        layout.SetupAttributes();
 
         glBindVertexArray(0);
     }
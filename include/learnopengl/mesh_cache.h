@@ -0,0 +1,354 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// bump whenever the on-disk layout or the processing done before writing changes,
+// so that stale cache files are rebuilt instead of being misread.
+const uint32_t MESH_CACHE_VERSION = 4;
+
+// read-only memory mapping of a whole file. the mapping lives as long as the object does.
+class MappedFile
+{
+public:
+    MappedFile() : data(nullptr), size(0) {}
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const string &path)
+    {
+        Close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size <= 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void *mapping = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping keeps its own reference to the file
+        if(mapping == MAP_FAILED)
+            return false;
+        data = (const unsigned char*)mapping;
+        size = (size_t)st.st_size;
+        return true;
+    }
+
+    void Close()
+    {
+        if(data)
+            munmap((void*)data, size);
+        data = nullptr;
+        size = 0;
+    }
+
+    const unsigned char *Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const unsigned char *data;
+    size_t size;
+};
+
+// file layout: header, one entry per mesh, then the string blob with texture references
+// ("type\0path\0" pairs) and finally the 4-byte aligned vertex, index and LOD range arrays.
+struct MeshCacheHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t importFlags;
+    uint32_t vertexSize;   // sizeof(Vertex) at write time, guards against struct layout changes
+    uint64_t sourceHash;
+    uint32_t meshCount;
+    uint32_t reserved;
+};
+
+struct MeshCacheEntry {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t textureOffset;
+    uint64_t lodOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;    // all levels of detail
+    uint32_t textureCount;
+    uint32_t lodCount;
+    uint32_t flags;         // MESH_CACHE_TRANSPARENT
+    uint32_t reserved;
+};
+
+const uint32_t MESH_CACHE_TRANSPARENT = 1;     // the material is not fully opaque
+
+// texture reference of a cached mesh, resolved against the model directory when loading
+struct MeshCacheTexture {
+    string type;
+    string path;
+};
+
+// a mesh as it is stored in the mapped cache file; the pointers are only valid while the MeshCache is open
+struct MeshCacheView {
+    const Vertex *vertices;
+    unsigned int vertexCount;
+    const unsigned int *indices;
+    unsigned int indexCount;
+    vector<MeshCacheTexture> textures;
+    vector<MeshLod> lods;
+    bool transparent;
+};
+
+class MeshCache
+{
+public:
+    vector<MeshCacheView> meshes;
+
+    // the cache file sits next to the source model
+    static string PathFor(const string &sourcePath)
+    {
+        return sourcePath + ".meshcache";
+    }
+
+    // hashes the OBJ and every material library it references, so editing either invalidates the cache
+    static uint64_t HashSource(const string &sourcePath)
+    {
+        string source;
+        if(!readFile(sourcePath, source))
+            return 0;
+        uint64_t hash = fnv1a(source.data(), source.size(), FNV_OFFSET);
+
+        size_t slash = sourcePath.find_last_of('/');
+        string directory = slash == string::npos ? "." : sourcePath.substr(0, slash);
+        istringstream lines(source);
+        string line;
+        while(getline(lines, line))
+        {
+            if(line.compare(0, 7, "mtllib ") != 0)
+                continue;
+            string name = trim(line.substr(7));
+            // a missing library hashes differently from an empty one, so it showing up later invalidates the cache too
+            string material;
+            if(!readFile(directory + '/' + name, material))
+                material = "\x01missing";
+            hash = fnv1a(name.data(), name.size(), hash);
+            hash = fnv1a(material.data(), material.size(), hash);
+        }
+        return hash;
+    }
+
+    // maps the cache file and validates it against the current source hash and import flags
+    bool Open(const string &cachePath, uint64_t sourceHash, unsigned int importFlags)
+    {
+        meshes.clear();
+        if(sourceHash == 0 || !file.Open(cachePath))
+            return false;
+
+        const unsigned char *base = file.Data();
+        const size_t size = file.Size();
+        if(size < sizeof(MeshCacheHeader))
+            return reject();
+
+        MeshCacheHeader header;
+        memcpy(&header, base, sizeof(header));
+        if(memcmp(header.magic, "UMSH", 4) != 0 || header.version != MESH_CACHE_VERSION ||
+           header.importFlags != importFlags || header.vertexSize != sizeof(Vertex) ||
+           header.sourceHash != sourceHash)
+            return reject();
+
+        size_t entriesEnd = sizeof(MeshCacheHeader) + (size_t)header.meshCount * sizeof(MeshCacheEntry);
+        if(entriesEnd > size)
+            return reject();
+
+        for(unsigned int i = 0; i < header.meshCount; i++)
+        {
+            MeshCacheEntry entry;
+            memcpy(&entry, base + sizeof(MeshCacheHeader) + i * sizeof(MeshCacheEntry), sizeof(entry));
+            if(entry.vertexOffset % alignof(Vertex) != 0 || entry.indexOffset % alignof(unsigned int) != 0 ||
+               entry.vertexOffset + (uint64_t)entry.vertexCount * sizeof(Vertex) > size ||
+               entry.indexOffset + (uint64_t)entry.indexCount * sizeof(unsigned int) > size ||
+               entry.lodOffset % alignof(MeshLod) != 0 || entry.lodOffset + (uint64_t)entry.lodCount * sizeof(MeshLod) > size ||
+               entry.textureOffset > size)
+                return reject();
+
+            MeshCacheView view;
+            view.vertices = (const Vertex*)(base + entry.vertexOffset);
+            view.vertexCount = entry.vertexCount;
+            view.indices = (const unsigned int*)(base + entry.indexOffset);
+            view.indexCount = entry.indexCount;
+            view.transparent = (entry.flags & MESH_CACHE_TRANSPARENT) != 0;
+            const MeshLod *lods = (const MeshLod*)(base + entry.lodOffset);
+            view.lods.assign(lods, lods + entry.lodCount);
+            for(const MeshLod &lod : view.lods)
+            {
+                if((uint64_t)lod.indexOffset + lod.indexCount > entry.indexCount)
+                    return reject();
+            }
+
+            const char *cursor = (const char*)base + entry.textureOffset;
+            const char *end = (const char*)base + size;
+            for(unsigned int t = 0; t < entry.textureCount; t++)
+            {
+                MeshCacheTexture texture;
+                if(!readString(cursor, end, texture.type) || !readString(cursor, end, texture.path))
+                    return reject();
+                view.textures.push_back(texture);
+            }
+            meshes.push_back(view);
+        }
+        return true;
+    }
+
+    // serializes the processed meshes; written to a temporary file first so a crash never leaves a torn cache behind
+    static bool Write(const string &cachePath, uint64_t sourceHash, unsigned int importFlags, const vector<MeshData> &meshes)
+    {
+        if(sourceHash == 0)
+            return false;
+
+        MeshCacheHeader header;
+        memcpy(header.magic, "UMSH", 4);
+        header.version = MESH_CACHE_VERSION;
+        header.importFlags = importFlags;
+        header.vertexSize = sizeof(Vertex);
+        header.sourceHash = sourceHash;
+        header.meshCount = (uint32_t)meshes.size();
+        header.reserved = 0;
+
+        // strings first, then the geometry aligned behind them
+        vector<MeshCacheEntry> entries(meshes.size());
+        string strings;
+        uint64_t stringsOffset = sizeof(MeshCacheHeader) + meshes.size() * sizeof(MeshCacheEntry);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            entries[i].textureOffset = stringsOffset + strings.size();
+            entries[i].textureCount = (uint32_t)meshes[i].textures.size();
+            for(const Texture &texture : meshes[i].textures)
+            {
+                strings.append(texture.type).push_back('\0');
+                strings.append(texture.path).push_back('\0');
+            }
+        }
+        uint64_t offset = align(stringsOffset + strings.size());
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            entries[i].vertexOffset = offset;
+            entries[i].vertexCount = meshes[i].VertexCount();
+            offset = align(offset + meshes[i].VertexCount() * sizeof(Vertex));
+            entries[i].indexOffset = offset;
+            entries[i].indexCount = meshes[i].IndexCount();
+            offset = align(offset + meshes[i].IndexCount() * sizeof(unsigned int));
+            entries[i].lodOffset = offset;
+            entries[i].lodCount = (uint32_t)meshes[i].lods.size();
+            entries[i].flags = meshes[i].transparent ? MESH_CACHE_TRANSPARENT : 0;
+            entries[i].reserved = 0;
+            offset = align(offset + meshes[i].lods.size() * sizeof(MeshLod));
+        }
+
+        string tmpPath = cachePath + ".tmp";
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        if(!out)
+            return false;
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)entries.data(), entries.size() * sizeof(MeshCacheEntry));
+        out.write(strings.data(), strings.size());
+        pad(out);
+        for(const MeshData &mesh : meshes)
+        {
+            out.write((const char*)mesh.VertexData(), mesh.VertexCount() * sizeof(Vertex));
+            pad(out);
+            out.write((const char*)mesh.IndexData(), mesh.IndexCount() * sizeof(unsigned int));
+            pad(out);
+            out.write((const char*)mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+            pad(out);
+        }
+        out.close();
+        if(!out || rename(tmpPath.c_str(), cachePath.c_str()) != 0)
+        {
+            cout << "ERROR::MESH_CACHE::WRITE_FAILED " << cachePath << endl;
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    MappedFile file;
+
+    static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+    static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+    static uint64_t fnv1a(const char *data, size_t size, uint64_t hash)
+    {
+        for(size_t i = 0; i < size; i++)
+        {
+            hash ^= (unsigned char)data[i];
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    static bool readFile(const string &path, string &contents)
+    {
+        ifstream in(path, ios::binary);
+        if(!in)
+            return false;
+        stringstream buffer;
+        buffer << in.rdbuf();
+        contents = buffer.str();
+        return true;
+    }
+
+    static string trim(const string &s)
+    {
+        size_t first = s.find_first_not_of(" \t\r");
+        if(first == string::npos)
+            return "";
+        size_t last = s.find_last_not_of(" \t\r");
+        return s.substr(first, last - first + 1);
+    }
+
+    static bool readString(const char *&cursor, const char *end, string &value)
+    {
+        if(cursor >= end)
+            return false;
+        const char *terminator = (const char*)memchr(cursor, '\0', end - cursor);
+        if(!terminator)
+            return false;
+        value.assign(cursor, terminator);
+        cursor = terminator + 1;
+        return true;
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 3) & ~(uint64_t)3;
+    }
+
+    static void pad(ofstream &out)
+    {
+        static const char zeros[4] = {0, 0, 0, 0};
+        out.write(zeros, align((uint64_t)out.tellp()) - (uint64_t)out.tellp());
+    }
+
+    bool reject()
+    {
+        meshes.clear();
+        file.Close();
+        return false;
+    }
+};
+#endif
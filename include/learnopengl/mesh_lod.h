@@ -0,0 +1,277 @@
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// level of detail chain generation. the simplified levels are index-only: they reuse the vertices of the full
+// mesh and are appended to its index buffer, so a LOD switch is nothing but a different index range.
+const unsigned int LOD_MAX_LEVELS = 4;           // full detail plus up to three simplified levels
+const unsigned int LOD_MIN_TRIANGLES = 256;      // meshes smaller than this are not worth simplifying
+const float        LOD_MAX_ERROR = 0.05f;        // largest geometric error of a collapse, relative to the mesh radius
+
+// symmetric 4x4 error quadric of a set of planes (Garland & Heckbert)
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+    static Quadric FromPlane(double a, double b, double c, double d)
+    {
+        Quadric q;
+        q.a2 = a * a; q.ab = a * b; q.ac = a * c; q.ad = a * d;
+        q.b2 = b * b; q.bc = b * c; q.bd = b * d;
+        q.c2 = c * c; q.cd = c * d;
+        q.d2 = d * d;
+        return q;
+    }
+
+    Quadric &operator+=(const Quadric &o)
+    {
+        a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+        b2 += o.b2; bc += o.bc; bd += o.bd;
+        c2 += o.c2; cd += o.cd;
+        d2 += o.d2;
+        return *this;
+    }
+
+    // sum of squared distances of p to the planes
+    double Evaluate(const glm::vec3 &p) const
+    {
+        const double x = p.x, y = p.y, z = p.z;
+        return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+             + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+             + c2 * z * z + 2 * cd * z
+             + d2;
+    }
+};
+
+// quadric error edge collapse decimation. collapses move a vertex onto one of its neighbours (half-edge
+// collapse), so no new vertices are created. vertices on uv/normal seams (several vertices sharing one
+// position) and on open borders are locked, which keeps seams and silhouettes of open meshes intact.
+class MeshSimplifier
+{
+public:
+    MeshSimplifier(const vector<Vertex> &meshVertices, const vector<unsigned int> &meshIndices)
+        : vertices(meshVertices), indices(meshIndices), quadrics(meshVertices.size()), locked(meshVertices.size(), false)
+    {
+        // seams: more than one vertex at the same position
+        struct PositionHash {
+            size_t operator()(const glm::vec3 &p) const
+            {
+                uint32_t bits[3];
+                memcpy(bits, &p, sizeof(bits));
+                return (size_t)bits[0] * 73856093u ^ (size_t)bits[1] * 19349663u ^ (size_t)bits[2] * 83492791u;
+            }
+        };
+        struct PositionEqual {
+            bool operator()(const glm::vec3 &a, const glm::vec3 &b) const { return memcmp(&a, &b, sizeof(glm::vec3)) == 0; }
+        };
+        unordered_map<glm::vec3, unsigned int, PositionHash, PositionEqual> positions;
+        for(unsigned int v = 0; v < vertices.size(); v++)
+        {
+            pair<unordered_map<glm::vec3, unsigned int, PositionHash, PositionEqual>::iterator, bool> found = positions.emplace(vertices[v].Position, v);
+            if(!found.second)
+                locked[v] = locked[found.first->second] = true;
+        }
+
+        // borders: edges used by a single triangle
+        unordered_map<uint64_t, unsigned int> edges;
+        for(size_t i = 0; i < indices.size(); i += 3)
+        {
+            for(unsigned int k = 0; k < 3; k++)
+                edges[edgeKey(indices[i + k], indices[i + (k + 1) % 3])]++;
+        }
+        for(const pair<const uint64_t, unsigned int> &edge : edges)
+        {
+            if(edge.second == 1)
+                locked[edge.first >> 32] = locked[edge.first & 0xFFFFFFFFu] = true;
+        }
+
+        for(size_t i = 0; i < indices.size(); i += 3)
+        {
+            const glm::vec3 &p0 = vertices[indices[i]].Position;
+            glm::vec3 n = glm::cross(vertices[indices[i + 1]].Position - p0, vertices[indices[i + 2]].Position - p0);
+            const float length = glm::length(n);
+            if(length <= 0.0f)
+                continue;
+            n = n / length;
+            const Quadric plane = Quadric::FromPlane(n.x, n.y, n.z, -glm::dot(n, p0));
+            for(unsigned int k = 0; k < 3; k++)
+                quadrics[indices[i + k]] += plane;
+        }
+
+        glm::vec3 low = vertices.empty() ? glm::vec3(0.0f) : vertices[0].Position, high = low;
+        for(const Vertex &vertex : vertices)
+        {
+            low = glm::vec3(min(low.x, vertex.Position.x), min(low.y, vertex.Position.y), min(low.z, vertex.Position.z));
+            high = glm::vec3(max(high.x, vertex.Position.x), max(high.y, vertex.Position.y), max(high.z, vertex.Position.z));
+        }
+        const double maxError = LOD_MAX_ERROR * 0.5 * glm::length(high - low);
+        maxCost = maxError * maxError;
+    }
+
+    // collapses edges, cheapest first, until at most targetIndexCount indices are left or every remaining
+    // collapse would exceed LOD_MAX_ERROR. successive calls continue from the previous result.
+    const vector<unsigned int> &Simplify(size_t targetIndexCount)
+    {
+        while(indices.size() > targetIndexCount && pass(targetIndexCount))
+            ;
+        return indices;
+    }
+
+private:
+    struct Collapse {
+        unsigned int from, to;
+        double cost;
+    };
+
+    const vector<Vertex> &vertices;
+    vector<unsigned int> indices;
+    vector<Quadric> quadrics;
+    vector<bool> locked;
+    double maxCost;
+
+    static uint64_t edgeKey(unsigned int a, unsigned int b)
+    {
+        return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+    }
+
+    // one round of independent collapses: every collapse locks the one-ring of the removed vertex, so the
+    // flip test of each collapse is still valid after the others have been applied
+    bool pass(size_t targetIndexCount)
+    {
+        const size_t triangleCount = indices.size() / 3;
+
+        vector<unsigned int> offsets(vertices.size() + 1, 0);
+        for(unsigned int index : indices)
+            offsets[index + 1]++;
+        for(size_t v = 0; v < vertices.size(); v++)
+            offsets[v + 1] += offsets[v];
+        vector<unsigned int> adjacency(indices.size());
+        vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for(size_t i = 0; i < indices.size(); i++)
+            adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+        vector<Collapse> collapses;
+        collapses.reserve(indices.size() * 2);
+        for(size_t t = 0; t < triangleCount; t++)
+        {
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                const unsigned int a = indices[t * 3 + k], b = indices[t * 3 + (k + 1) % 3];
+                Quadric q = quadrics[a];
+                q += quadrics[b];
+                if(!locked[a])
+                    collapses.push_back({ a, b, q.Evaluate(vertices[b].Position) });
+                if(!locked[b])
+                    collapses.push_back({ b, a, q.Evaluate(vertices[a].Position) });
+            }
+        }
+        sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+
+        vector<unsigned int> remap(vertices.size());
+        for(unsigned int v = 0; v < remap.size(); v++)
+            remap[v] = v;
+        vector<bool> touched(vertices.size(), false);
+        const size_t trianglesToRemove = (indices.size() - targetIndexCount + 2) / 3;
+        size_t removed = 0;
+        for(const Collapse &collapse : collapses)
+        {
+            if(removed >= trianglesToRemove || collapse.cost > maxCost)
+                break;
+            if(touched[collapse.from] || touched[collapse.to] || flips(collapse, offsets, adjacency))
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            for(unsigned int a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++)
+            {
+                const unsigned int *triangle = &indices[adjacency[a] * 3];
+                bool shared = false;
+                for(unsigned int k = 0; k < 3; k++)
+                {
+                    touched[triangle[k]] = true;
+                    shared = shared || triangle[k] == collapse.to;
+                }
+                removed += shared ? 1 : 0;
+            }
+        }
+        if(removed == 0)
+            return false;
+
+        vector<unsigned int> simplified;
+        simplified.reserve(indices.size() - removed * 3);
+        for(size_t t = 0; t < triangleCount; t++)
+        {
+            const unsigned int a = remap[indices[t * 3]], b = remap[indices[t * 3 + 1]], c = remap[indices[t * 3 + 2]];
+            if(a == b || b == c || a == c)
+                continue;
+            simplified.push_back(a);
+            simplified.push_back(b);
+            simplified.push_back(c);
+        }
+        indices.swap(simplified);
+        return true;
+    }
+
+    // rejects collapses that would turn a surviving triangle over (or close to it)
+    bool flips(const Collapse &collapse, const vector<unsigned int> &offsets, const vector<unsigned int> &adjacency) const
+    {
+        for(unsigned int a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++)
+        {
+            const unsigned int *triangle = &indices[adjacency[a] * 3];
+            if(triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                continue;
+            glm::vec3 before[3], after[3];
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                before[k] = vertices[triangle[k]].Position;
+                after[k] = triangle[k] == collapse.from ? vertices[collapse.to].Position : before[k];
+            }
+            const glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+            const glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if(glm::dot(n0, n1) <= 0.25f * glm::length(n0) * glm::length(n1))
+                return true;
+        }
+        return false;
+    }
+};
+
+// appends up to LOD_MAX_LEVELS - 1 simplified levels, each with about half the triangles of the previous one,
+// behind the full detail indices and returns the index range of every level. levels that would not save at least
+// a quarter of the triangles of the previous one are not generated, the chain simply ends there.
+inline vector<MeshLod> GenerateLods(const vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    vector<MeshLod> lods;
+    lods.push_back({ 0, (unsigned int)indices.size() });
+    if(indices.size() / 3 < LOD_MIN_TRIANGLES)
+        return lods;
+
+    MeshSimplifier simplifier(vertices, indices);
+    size_t previous = indices.size();
+    for(unsigned int level = 1; level < LOD_MAX_LEVELS; level++)
+    {
+        vector<unsigned int> simplified = simplifier.Simplify(previous / 2 / 3 * 3);
+        if(simplified.size() > previous * 3 / 4)
+            break;
+
+        // each level gets its own cache friendly order
+        vector<unsigned int> triangles = TipsifyTriangles(simplified, vertices.size());
+        MeshLod lod = { (unsigned int)indices.size(), (unsigned int)simplified.size() };
+        for(unsigned int triangle : triangles)
+            indices.insert(indices.end(), simplified.begin() + triangle * 3, simplified.begin() + triangle * 3 + 3);
+        lods.push_back(lod);
+        previous = simplified.size();
+    }
+    return lods;
+}
+#endif
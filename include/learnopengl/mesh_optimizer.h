@@ -0,0 +1,376 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// import-time geometry optimization, run once per mesh before it goes into the mesh cache:
+//   1. weld identical vertices (OBJ faces come in with unshared vertices)
+//   2. reorder triangles for the post-transform vertex cache (Tipsify, Sander et al. 2007)
+//   3. reorder the resulting clusters of triangles so outward facing ones draw first (less overdraw)
+//   4. reorder the vertices in order of first use for vertex fetch locality
+// the simulated FIFO cache has the size Tipsify optimizes for; 16 is a conservative figure for current GPUs.
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+struct MeshOptimizerStats {
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    size_t triangles = 0;
+    size_t missesBefore = 0;
+    size_t missesAfter = 0;
+
+    // average cache miss ratio: transformed vertices per triangle, 3 is the worst case, ~0.5-0.7 is ideal
+    float AcmrBefore() const { return triangles ? (float)missesBefore / triangles : 0.0f; }
+    float AcmrAfter() const { return triangles ? (float)missesAfter / triangles : 0.0f; }
+
+    MeshOptimizerStats &operator+=(const MeshOptimizerStats &other)
+    {
+        verticesBefore += other.verticesBefore;
+        verticesAfter += other.verticesAfter;
+        triangles += other.triangles;
+        missesBefore += other.missesBefore;
+        missesAfter += other.missesAfter;
+        return *this;
+    }
+};
+
+// number of vertex shader invocations the index order costs with a FIFO cache of the given size
+inline size_t SimulateVertexCache(const unsigned int *indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    // a vertex is cached while fewer than cacheSize misses happened since it was inserted
+    vector<size_t> inserted(vertexCount, 0);
+    size_t time = cacheSize + 1;
+    size_t misses = 0;
+    for(size_t i = 0; i < indexCount; i++)
+    {
+        const unsigned int v = indices[i];
+        if(time - inserted[v] > cacheSize)
+        {
+            inserted[v] = time++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+// merges vertices with the same position, normal and uv. the tangent frame of the merged vertex is the
+// average of the originals, which is what assimp computes for vertices that were shared to begin with.
+inline void WeldVertices(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    struct Key {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 texCoords;
+    };
+    struct KeyHash {
+        size_t operator()(const Key &key) const
+        {
+            // FNV-1a over the raw bytes, equality below is bitwise as well
+            const unsigned char *bytes = (const unsigned char*)&key;
+            size_t hash = 14695981039346656037ull;
+            for(size_t i = 0; i < sizeof(Key); i++)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            return hash;
+        }
+    };
+    struct KeyEqual {
+        bool operator()(const Key &a, const Key &b) const { return memcmp(&a, &b, sizeof(Key)) == 0; }
+    };
+
+    unordered_map<Key, unsigned int, KeyHash, KeyEqual> unique;
+    unique.reserve(vertices.size());
+    vector<unsigned int> remap(vertices.size());
+    vector<Vertex> welded;
+    welded.reserve(vertices.size());
+    for(size_t i = 0; i < vertices.size(); i++)
+    {
+        Key key;    // 8 floats, no padding to clear
+        key.position = vertices[i].Position;
+        key.normal = vertices[i].Normal;
+        key.texCoords = vertices[i].TexCoords;
+        pair<unordered_map<Key, unsigned int, KeyHash, KeyEqual>::iterator, bool> found = unique.emplace(key, (unsigned int)welded.size());
+        if(found.second)
+            welded.push_back(vertices[i]);
+        else
+        {
+            Vertex &target = welded[found.first->second];
+            target.Tangent = target.Tangent + vertices[i].Tangent;
+            target.Bitangent = target.Bitangent + vertices[i].Bitangent;
+        }
+        remap[i] = found.first->second;
+    }
+    if(welded.size() == vertices.size())
+        return;
+
+    for(Vertex &vertex : welded)
+    {
+        // Gram-Schmidt the summed tangent against the normal, keep the handedness of the summed bitangent
+        const glm::vec3 &n = vertex.Normal;
+        glm::vec3 t = vertex.Tangent - n * (n.x * vertex.Tangent.x + n.y * vertex.Tangent.y + n.z * vertex.Tangent.z);
+        const float length = sqrt(t.x * t.x + t.y * t.y + t.z * t.z);
+        if(length < 1e-8f)
+            continue;
+        t = t * (1.0f / length);
+        glm::vec3 b(n.y * t.z - n.z * t.y, n.z * t.x - n.x * t.z, n.x * t.y - n.y * t.x);
+        if(b.x * vertex.Bitangent.x + b.y * vertex.Bitangent.y + b.z * vertex.Bitangent.z < 0.0f)
+            b = b * -1.0f;
+        vertex.Tangent = t;
+        vertex.Bitangent = b;
+    }
+    for(unsigned int &index : indices)
+        index = remap[index];
+    vertices.swap(welded);
+}
+
+// Tipsify: returns the triangles in cache friendly order. fans around the vertex that stays in the cache
+// longest and falls back to recently used vertices (and finally any vertex) when it runs into a dead end.
+inline vector<unsigned int> TipsifyTriangles(const vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    const size_t triangleCount = indices.size() / 3;
+
+    // vertex -> triangles adjacency, and the number of not yet emitted triangles per vertex
+    vector<unsigned int> live(vertexCount, 0);
+    for(unsigned int index : indices)
+        live[index]++;
+    vector<unsigned int> offsets(vertexCount + 1, 0);
+    for(size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + live[v];
+    vector<unsigned int> adjacency(indices.size());
+    vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < indices.size(); i++)
+        adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+    vector<size_t> cacheTime(vertexCount, 0);
+    vector<bool> emitted(triangleCount, false);
+    vector<unsigned int> deadEnd;
+    vector<unsigned int> candidates;
+    vector<unsigned int> order;
+    order.reserve(triangleCount);
+    size_t time = cacheSize + 1;
+    size_t cursor = 0;
+
+    auto skipDeadEnd = [&]() -> long long {
+        while(!deadEnd.empty())
+        {
+            unsigned int v = deadEnd.back();
+            deadEnd.pop_back();
+            if(live[v] > 0)
+                return v;
+        }
+        for(; cursor < vertexCount; cursor++)
+        {
+            if(live[cursor] > 0)
+                return (long long)cursor;
+        }
+        return -1;
+    };
+
+    long long fan = skipDeadEnd();
+    while(fan >= 0)
+    {
+        candidates.clear();
+        for(unsigned int a = offsets[fan]; a < offsets[fan + 1]; a++)
+        {
+            const unsigned int triangle = adjacency[a];
+            if(emitted[triangle])
+                continue;
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                const unsigned int v = indices[triangle * 3 + k];
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if(time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+            emitted[triangle] = true;
+            order.push_back(triangle);
+        }
+
+        // next fan: the candidate that will still be in the cache after its remaining triangles, oldest first
+        long long best = -1;
+        long long bestPriority = -1;
+        for(unsigned int v : candidates)
+        {
+            if(live[v] == 0)
+                continue;
+            long long priority = 0;
+            if(time - cacheTime[v] + 2 * live[v] <= cacheSize)
+                priority = (long long)(time - cacheTime[v]);
+            if(priority > bestPriority)
+            {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+        fan = best >= 0 ? best : skipDeadEnd();
+    }
+    return order;
+}
+
+// reorders clusters of the cache optimized triangle order so that clusters facing away from the mesh center
+// come first; they are the ones most likely to occlude the rest (Sander et al., "fast linear-speed overdraw").
+// clusters start where the cache is effectively flushed and are split further as long as each piece keeps its
+// cache efficiency within `threshold` of the whole, so the ACMR gained by Tipsify is mostly kept.
+inline void OptimizeOverdraw(const vector<Vertex> &vertices, vector<unsigned int> &indices, float threshold = 1.05f, unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if(triangleCount < 2)
+        return;
+
+    // misses per triangle in the current order
+    vector<unsigned char> misses(triangleCount);
+    {
+        vector<size_t> inserted(vertices.size(), 0);
+        size_t time = cacheSize + 1;
+        for(size_t t = 0; t < triangleCount; t++)
+        {
+            misses[t] = 0;
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                const unsigned int v = indices[t * 3 + k];
+                if(time - inserted[v] > cacheSize)
+                {
+                    inserted[v] = time++;
+                    misses[t]++;
+                }
+            }
+        }
+    }
+
+    // hard boundaries where all three vertices missed, soft ones inside while the pieces stay efficient
+    vector<size_t> clusters;
+    for(size_t t = 0; t < triangleCount; t++)
+    {
+        if(t == 0 || misses[t] == 3)
+            clusters.push_back(t);
+    }
+    clusters.push_back(triangleCount);
+    vector<size_t> split;
+    for(size_t c = 0; c + 1 < clusters.size(); c++)
+    {
+        const size_t begin = clusters[c], end = clusters[c + 1];
+        size_t total = 0;
+        for(size_t t = begin; t < end; t++)
+            total += misses[t];
+        const float clusterAcmr = (float)total / (end - begin);
+
+        split.push_back(begin);
+        size_t start = begin, pieceMisses = 0;
+        for(size_t t = begin; t < end; t++)
+        {
+            pieceMisses += misses[t];
+            const size_t pieceTriangles = t + 1 - start;
+            if(t + 1 < end && misses[t + 1] > 0 && pieceTriangles >= cacheSize &&
+               (float)pieceMisses / pieceTriangles <= clusterAcmr * threshold)
+            {
+                split.push_back(t + 1);
+                start = t + 1;
+                pieceMisses = 0;
+            }
+        }
+    }
+    split.push_back(triangleCount);
+    const size_t clusterCount = split.size() - 1;
+    if(clusterCount < 2)
+        return;
+
+    // area weighted centroid and normal per cluster
+    vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+    vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+    vector<float> areas(clusterCount, 0.0f);
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for(size_t c = 0; c < clusterCount; c++)
+    {
+        for(size_t t = split[c]; t < split[c + 1]; t++)
+        {
+            const glm::vec3 &p0 = vertices[indices[t * 3 + 0]].Position;
+            const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].Position;
+            const glm::vec3 e1 = p1 - p0, e2 = p2 - p0;
+            const glm::vec3 n(e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x);
+            const float area = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+            centroids[c] = centroids[c] + (p0 + p1 + p2) * (area / 3.0f);
+            normals[c] = normals[c] + n;
+            areas[c] += area;
+        }
+        meshCentroid = meshCentroid + centroids[c];
+        meshArea += areas[c];
+    }
+    if(meshArea <= 0.0f)
+        return;
+    meshCentroid = meshCentroid * (1.0f / meshArea);
+
+    vector<float> sortKey(clusterCount, 0.0f);
+    for(size_t c = 0; c < clusterCount; c++)
+    {
+        if(areas[c] <= 0.0f)
+            continue;
+        const glm::vec3 offset = centroids[c] * (1.0f / areas[c]) - meshCentroid;
+        const glm::vec3 &n = normals[c];
+        const float length = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+        if(length > 0.0f)
+            sortKey[c] = (offset.x * n.x + offset.y * n.y + offset.z * n.z) / length;
+    }
+    vector<size_t> order(clusterCount);
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+    vector<unsigned int> sorted;
+    sorted.reserve(indices.size());
+    for(size_t c : order)
+        sorted.insert(sorted.end(), indices.begin() + split[c] * 3, indices.begin() + split[c + 1] * 3);
+    indices.swap(sorted);
+}
+
+// renumbers the vertices in the order the index buffer first touches them, dropping unused ones
+inline void OptimizeVertexFetch(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    const unsigned int unused = ~0u;
+    vector<unsigned int> remap(vertices.size(), unused);
+    vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for(unsigned int &index : indices)
+    {
+        if(remap[index] == unused)
+        {
+            remap[index] = (unsigned int)ordered.size();
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+// the whole pipeline, returns the numbers for the import log
+inline MeshOptimizerStats OptimizeMesh(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    MeshOptimizerStats stats;
+    stats.verticesBefore = vertices.size();
+    stats.triangles = indices.size() / 3;
+    stats.missesBefore = SimulateVertexCache(indices.data(), indices.size(), vertices.size());
+
+    WeldVertices(vertices, indices);
+    vector<unsigned int> triangles = TipsifyTriangles(indices, vertices.size());
+    vector<unsigned int> reordered;
+    reordered.reserve(indices.size());
+    for(unsigned int triangle : triangles)
+        reordered.insert(reordered.end(), indices.begin() + triangle * 3, indices.begin() + triangle * 3 + 3);
+    indices.swap(reordered);
+    OptimizeOverdraw(vertices, indices);
+    OptimizeVertexFetch(vertices, indices);
+
+    stats.verticesAfter = vertices.size();
+    stats.missesAfter = SimulateVertexCache(indices.data(), indices.size(), vertices.size());
+    return stats;
+}
+#endif
@@ -11,18 +11,47 @@
 #include <assimp/postprocess.h>
 
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_lod.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/resource_cache.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/thread_pool.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
+#include <memory>
+#include <future>
+#include <iterator>
+#include <utility>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// screen size, as a projected bounding sphere diameter in pixels, at which a model is drawn at full detail.
+// every halving of the size drops one level of detail.
+const float LOD_FULL_DETAIL_PIXELS = 512.0f;
+// how far past a level boundary (in levels) the size has to move before the level actually changes
+const float LOD_HYSTERESIS = 0.2f;
+
+// level of detail currently used by one drawn instance of a model, owned by whoever draws it
+struct LodState {
+    unsigned int level = 0;
+};
+
+// geometry footprint of a model: what is still held in system memory and what sits in GL buffers
+struct GeometryMemory {
+    size_t cpuBytes = 0;
+    size_t gpuBytes = 0;
+};
+
 
 
 class Model
@@ -33,18 +62,234 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    VertexFormat vertexFormat;  // how the vertices are stored on the GPU, see SetVertexFormat
+    glm::vec3 boundsCenter = glm::vec3(0.0f);  // bounding sphere in model space
+    float boundsRadius = 0.0f;
+    GeometryResidency residency = GEOMETRY_GPU_ONLY;
 
-    // constructor, expects a filepath to a 3D model.
+    // constructor, expects a filepath to a 3D model. imports and uploads in one go on the calling thread.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    {
+        Import(path);
+        Upload();
+    }
+
+    // empty model, to be filled by Import (any thread) followed by Upload (context thread).
+    Model() : gammaCorrection(false)
+    {
+    }
+
+    // unloading a model deletes its buffers (through the mesh handles) and gives the textures back to
+    // the shared cache, which deletes them once nobody else uses them
+    ~Model()
+    {
+        releaseTextures();
+    }
+
+    // models own GL objects and texture references: they can be moved, never copied
+    Model(Model &&other) = default;
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    Model& operator=(Model &&other)
+    {
+        if(this != &other)
+        {
+            releaseTextures();
+            textures_loaded = std::move(other.textures_loaded);
+            other.textures_loaded.clear();
+            meshes = std::move(other.meshes);
+            directory = std::move(other.directory);
+            gammaCorrection = other.gammaCorrection;
+            vertexFormat = other.vertexFormat;
+            boundsCenter = other.boundsCenter;
+            boundsRadius = other.boundsRadius;
+            boundsBox[0] = other.boundsBox[0];
+            boundsBox[1] = other.boundsBox[1];
+            residency = other.residency;
+            pendingMeshes = std::move(other.pendingMeshes);
+            textureIndex = std::move(other.textureIndex);
+            cache = std::move(other.cache);
+            instanceBuffer = std::move(other.instanceBuffer);
+        }
+        return *this;
+    }
+
+    // CPU phase: reads the file (or its mesh cache), processes the meshes and collects the texture paths.
+    // does not call into OpenGL, so different models can be imported concurrently from worker threads.
+    void Import(string const &path)
     {
         loadModel(path);
+        computeBounds();
+        // one quantization box for the whole model, so its meshes share the dequantization uniforms and
+        // can be merged into one multi-draw
+        for(MeshData &data : pendingMeshes)
+            data.Pack(vertexFormat, boundsBox);
+    }
+
+    // stores the vertices in the given (usually more compact) format from the next Import on.
+    // typically VertexFormat::FromProgram of the shader the model is drawn with.
+    void SetVertexFormat(const VertexFormat &format)
+    {
+        vertexFormat = format;
+    }
+
+    // GL phase: uploads everything Import produced and releases the CPU-side staging data.
+    // must be called on the thread that owns the OpenGL context. textures are only requested here,
+    // they are decoded and streamed in by the TextureLoader while the model already renders.
+    void Upload()
+    {
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+        {
+            textures_loaded[i].id = TextureFromFile(textures_loaded[i].path.c_str(), directory, gammaCorrection);
+        }
+        for(MeshData &data : pendingMeshes)
+        {
+            // resolve the texture ids now that the textures exist
+            for(Texture &texture : data.textures)
+                texture.id = findLoadedTexture(texture.path.c_str())->id;
+            if(!data.packedVertices.empty() || data.mappedVertices)
+            {
+                if(!data.packedVertices.empty())
+                    meshes.emplace_back(data.packedVertices.data(), data.VertexCount(), data.layout, data.IndexData(), data.IndexCount(), std::move(data.textures));
+                else
+                    meshes.emplace_back(data.VertexData(), data.VertexCount(), data.IndexData(), data.IndexCount(), std::move(data.textures));
+                if(residency == GEOMETRY_KEEP_CPU)
+                    meshes.back().KeepGeometry(data.VertexData(), data.VertexCount(), data.IndexData(), data.IndexCount());
+            }
+            else
+                meshes.emplace_back(std::move(data.vertices), std::move(data.indices), std::move(data.textures), residency);
+            if(!data.lods.empty())
+                meshes.back().lods = std::move(data.lods);
+            meshes.back().bounds = data.bounds;
+            meshes.back().transparent = data.transparent;
+        }
+        pendingMeshes.clear();
+        cache.reset();
+    }
+
+    // keeps a CPU copy of the geometry in every mesh from the next Upload on, for consumers that read it back
+    void SetGeometryResidency(GeometryResidency geometryResidency)
+    {
+        residency = geometryResidency;
+    }
+
+    GeometryMemory MemoryUsage() const
+    {
+        GeometryMemory memory;
+        for(const Mesh &mesh : meshes)
+        {
+            memory.cpuBytes += mesh.CpuBytes();
+            memory.gpuBytes += mesh.GpuBytes();
+        }
+        // staging data of a model that was imported but not uploaded yet
+        for(const MeshData &data : pendingMeshes)
+        {
+            memory.cpuBytes += data.vertices.capacity() * sizeof(Vertex) + data.indices.capacity() * sizeof(unsigned int);
+            memory.cpuBytes += data.packedVertices.capacity();
+        }
+        return memory;
+    }
+
+    // draws the model, and thus all its meshes, at the given level of detail
+    void Draw(Shader &shader, unsigned int lod = 0)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Draw(shader, lod);
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    // records the meshes into a render queue instead of drawing them right away. with occlusion culling on
+    // they are drawn only if the model's box was visible last frame; the query is kept per occlusionKey (the
+    // model itself if null), so a model enqueued several times a frame needs a distinct key for each copy.
+    void Enqueue(RenderQueue &queue, RenderPass pass, Shader &shader, const glm::mat4 &model, unsigned int lod, float depth,
+                 const void *occlusionKey = nullptr)
     {
+        const GLuint condition = queue.OcclusionCondition(occlusionKey ? occlusionKey : this, Bounds().Transformed(model));
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            queue.Add(pass, shader, meshes[i], lod, model, depth, RenderState(), condition);
+    }
+
+    // draws one copy of the model per model matrix, with a single instanced draw call per mesh. the shader
+    // reads the matrices as a per-instance attribute (2.model_lighting_instanced.vs) instead of a model uniform.
+    void DrawInstanced(Shader &shader, const glm::mat4 *models, unsigned int count, unsigned int lod = 0)
+    {
+        uploadInstances(instanceBuffer, models, count);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, instanceBuffer.Get(), count, lod);
+    }
+
+    // records an instanced draw of the model. instances outside of the queue's frustum are dropped and the
+    // rest is uploaded right away into instanceBuffer (created if empty), so each buffer can be enqueued only
+    // once per submitted frame; batches of the same model need a buffer each. the draws share one occlusion
+    // query around the visible instances, kept per occlusionKey like in Enqueue, so the instances of a batch
+    // should lie close together for the box to ever be hidden.
+    void EnqueueInstanced(RenderQueue &queue, RenderPass pass, Shader &shader, const glm::mat4 *models, unsigned int count, unsigned int lod, float depth,
+                          BufferHandle &instanceBuffer, const void *occlusionKey = nullptr)
+    {
+        const unsigned int visible = queue.CullInstances(Bounds(), models, count, visibleInstances, (unsigned int)meshes.size());
+        if(visible == 0)
+            return;
+        uploadInstances(instanceBuffer, visibleInstances.data(), visible);
+        // conditional rendering skips whole draws, so all instances share one box around them
+        BoundingVolume instancesBounds = Bounds().Transformed(visibleInstances[0]);
+        glm::vec3 low = instancesBounds.center - instancesBounds.extents, high = instancesBounds.center + instancesBounds.extents;
+        for(unsigned int i = 1; i < visible; i++)
+        {
+            const BoundingVolume world = Bounds().Transformed(visibleInstances[i]);
+            low = glm::min(low, world.center - world.extents);
+            high = glm::max(high, world.center + world.extents);
+        }
+        instancesBounds.center = (low + high) * 0.5f;
+        instancesBounds.extents = (high - low) * 0.5f;
+        instancesBounds.radius = glm::length(instancesBounds.extents);
+        const GLuint condition = queue.OcclusionCondition(occlusionKey ? occlusionKey : this, instancesBounds);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            queue.AddInstanced(pass, shader, meshes[i], lod, instanceBuffer.Get(), visible, depth, RenderState(), condition);
+    }
+
+    // model space bounds of all meshes together
+    BoundingVolume Bounds() const
+    {
+        BoundingVolume bounds;
+        bounds.center = boundsCenter;
+        bounds.extents = (boundsBox[1] - boundsBox[0]) * 0.5f;
+        bounds.radius = boundsRadius;
+        return bounds;
+    }
+
+    unsigned int LodCount() const
+    {
+        unsigned int count = 1;
+        for(const Mesh &mesh : meshes)
+            count = max(count, (unsigned int)mesh.lods.size());
+        return count;
+    }
+
+    // picks the level of detail for one instance from the size of its projected bounding sphere and remembers
+    // it in state. the level only changes once the size is LOD_HYSTERESIS levels past the boundary, so an
+    // instance hovering around a boundary does not pop back and forth every frame.
+    unsigned int SelectLod(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection, float viewportHeight, LodState &state) const
+    {
+        const glm::vec4 center = view * model * glm::vec4(boundsCenter, 1.0f);
+        const float scale = max(glm::length(glm::vec3(model[0])), max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        const float radius = boundsRadius * scale;
+        const float distance = -center.z;
+        if(distance <= radius)
+        {
+            state.level = 0;    // camera inside or touching the sphere
+            return state.level;
+        }
+        const float pixels = 2.0f * radius * projection[1][1] * 0.5f * viewportHeight / distance;
+        const float level = log2(LOD_FULL_DETAIL_PIXELS / max(pixels, 1e-3f));
+
+        const unsigned int levels = LodCount();
+        unsigned int selected = min(state.level, levels - 1);
+        while(selected + 1 < levels && level > selected + 1 + LOD_HYSTERESIS)
+            selected++;
+        while(selected > 0 && level < selected - LOD_HYSTERESIS)
+            selected--;
+        state.level = selected;
+        return selected;
     }
 
     void SetShaderTextureNamePrefix(std::string prefix) {
@@ -53,27 +298,122 @@ public:
         }
     }
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // staging data between Import and Upload
+    vector<MeshData>      pendingMeshes;
+    unordered_map<string, unsigned int> textureIndex;   // path -> position in textures_loaded
+    unique_ptr<MeshCache> cache;           // keeps a mapped cache file alive until its geometry is uploaded
+    BufferHandle          instanceBuffer;  // model matrices of the last DrawInstanced
+    glm::vec3             boundsBox[2];    // axis aligned bounds (low, high) of all meshes, set by computeBounds
+    vector<glm::mat4>     visibleInstances;    // instances of the last EnqueueInstanced that passed culling
+
+    // replaces the contents of the instance buffer; glBufferData orphans the old storage, so a draw
+    // still reading it does not stall the upload
+    static void uploadInstances(BufferHandle &buffer, const glm::mat4 *models, unsigned int count)
+    {
+        if(!buffer)
+            buffer = BufferHandle::Create();
+        glBindBuffer(GL_ARRAY_BUFFER, buffer.Get());
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), models, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // bounding sphere around the axis aligned bounds of all meshes
+    void computeBounds()
+    {
+        bool empty = true;
+        glm::vec3 low(0.0f), high(0.0f);
+        for(const MeshData &data : pendingMeshes)
+        {
+            const Vertex *vertices = data.VertexData();
+            for(unsigned int i = 0; i < data.VertexCount(); i++)
+            {
+                const glm::vec3 &p = vertices[i].Position;
+                low = empty ? p : glm::vec3(min(low.x, p.x), min(low.y, p.y), min(low.z, p.z));
+                high = empty ? p : glm::vec3(max(high.x, p.x), max(high.y, p.y), max(high.z, p.z));
+                empty = false;
+            }
+        }
+        boundsBox[0] = low;
+        boundsBox[1] = high;
+        boundsCenter = (low + high) * 0.5f;
+        boundsRadius = 0.0f;
+        for(const MeshData &data : pendingMeshes)
+        {
+            const Vertex *vertices = data.VertexData();
+            for(unsigned int i = 0; i < data.VertexCount(); i++)
+                boundsRadius = max(boundsRadius, glm::length(vertices[i].Position - boundsCenter));
+        }
+    }
+
+    void releaseTextures()
+    {
+        for(const Texture &texture : textures_loaded)
+        {
+            if(texture.id)
+                TextureCache::Instance().Release(texture.id);
+        }
+        textures_loaded.clear();
+    }
+
+    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in pendingMeshes.
     void loadModel(string const &path)
     {
+        const unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        // a valid cache lets us skip ASSIMP entirely and upload straight from the mapped file
+        const uint64_t sourceHash = MeshCache::HashSource(path);
+        const string cachePath = MeshCache::PathFor(path);
+        if(loadFromCache(cachePath, sourceHash, importFlags))
+            return;
+
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, importFlags);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        MeshOptimizerStats stats;
+        processNode(scene->mRootNode, scene, stats);
+        cout << "MODEL::OPTIMIZED " << path << ": " << stats.verticesBefore << " -> " << stats.verticesAfter
+             << " vertices, ACMR " << stats.AcmrBefore() << " -> " << stats.AcmrAfter() << endl;
+
+        MeshCache::Write(cachePath, sourceHash, importFlags, pendingMeshes);
+    }
+
+    // rebuilds the meshes from a mesh cache file, returns false if the cache is missing or stale
+    bool loadFromCache(const string &cachePath, uint64_t sourceHash, unsigned int importFlags)
+    {
+        unique_ptr<MeshCache> mapped(new MeshCache);
+        if(!mapped->Open(cachePath, sourceHash, importFlags))
+            return false;
+
+        for(const MeshCacheView &view : mapped->meshes)
+        {
+            MeshData data;
+            data.mappedVertices = view.vertices;
+            data.mappedVertexCount = view.vertexCount;
+            data.mappedIndices = view.indices;
+            data.mappedIndexCount = view.indexCount;
+            data.lods = view.lods;
+            data.bounds = BoundingVolume::FromVertices(view.vertices, view.vertexCount);
+            data.transparent = view.transparent;
+            for(const MeshCacheTexture &texture : view.textures)
+                data.textures.push_back(loadMaterialTexture(texture.path.c_str(), texture.type));
+            pendingMeshes.push_back(std::move(data));
+        }
+        cache = std::move(mapped);
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    void processNode(aiNode *node, const aiScene *scene, MeshOptimizerStats &stats)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -81,22 +421,26 @@ private:
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            pendingMeshes.push_back(processMesh(mesh, scene, stats));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, stats);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    MeshData processMesh(aiMesh *mesh, const aiScene *scene, MeshOptimizerStats &stats)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<Texture> &textures = data.textures;
+
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(mesh->mNumFaces * 3);
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -151,6 +495,11 @@ private:
             for(unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);
         }
+        // weld and reorder for the vertex cache, overdraw and vertex fetch; the mesh cache stores the result
+        stats += OptimizeMesh(vertices, indices);
+        // simplified levels of detail, appended behind the full index range
+        data.lods = GenerateLods(vertices, indices);
+        data.bounds = BoundingVolume::FromVertices(vertices.data(), vertices.size());
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -161,25 +510,28 @@ private:
         // normal: texture_normalN
         aiColor3D color(0.0f, 0.0f, 0.0f);
         material->Get(AI_MATKEY_COLOR_AMBIENT, color);
+        float opacity = 1.0f;
+        material->Get(AI_MATKEY_OPACITY, opacity);
+        data.transparent = opacity < 1.0f;
 
 
         // 1. diffuse maps
         vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        textures.insert(textures.end(), make_move_iterator(diffuseMaps.begin()), make_move_iterator(diffuseMaps.end()));
         // 2. specular maps
         vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        textures.insert(textures.end(), make_move_iterator(specularMaps.begin()), make_move_iterator(specularMaps.end()));
         // 3. normal maps
         std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        textures.insert(textures.end(), make_move_iterator(normalMaps.begin()), make_move_iterator(normalMaps.end()));
         // 4. height maps
         std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        textures.insert(textures.end(), make_move_iterator(heightMaps.begin()), make_move_iterator(heightMaps.end()));
 
 
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the extracted mesh data, it becomes a mesh object once uploaded
+        return data;
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -191,70 +543,63 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back(loadMaterialTexture(str.C_Str(), typeName));
         }
         return textures;
     }
-};
 
+    // registers a single texture relative to the model directory, unless it was registered before.
+    // the returned texture gets its id in Upload.
+    Texture loadMaterialTexture(const char *path, const string &typeName)
+    {
+        // check if texture was loaded before and if so, skip loading a new texture
+        const Texture *loaded = findLoadedTexture(path);
+        if(loaded)
+            return *loaded; // a texture with the same filepath has already been loaded, reuse it. (optimization)
+        // if texture hasn't been loaded already, remember it for Upload
+        Texture texture;
+        texture.id = 0;
+        texture.type = typeName;
+        texture.path = path;
+        textureIndex[texture.path] = textures_loaded.size();
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        return texture;
+    }
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
+    const Texture *findLoadedTexture(const char *path) const
+    {
+        unordered_map<string, unsigned int>::const_iterator loaded = textureIndex.find(path);
+        return loaded != textureIndex.end() ? &textures_loaded[loaded->second] : nullptr;
+    }
+};
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-//    stbi_set_flip_vertically_on_load(true);     // Proveri da li treba da se flipuju teksture prilikom ucitavanja????
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+// loads several models at once: the CPU phase of every model runs on the pool, and each model is
+// uploaded on the calling (context) thread as soon as its import is done.
+void LoadModels(const vector<pair<Model*, string>> &models, ThreadPool &pool)
+{
+    vector<future<void>> imports;
+    for(const pair<Model*, string> &job : models)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+        Model *model = job.first;
+        string path = job.second;
+        imports.push_back(pool.Submit([model, path] { model->Import(path); }));
     }
-    else
+    for(unsigned int i = 0; i < models.size(); i++)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        imports[i].get();
+        models[i].first->Upload();
     }
+}
+
+
+// returns immediately; the texture shows a placeholder until the TextureLoader has decoded and uploaded the file.
+// the id is a reference into the shared TextureCache and has to be given back with TextureCache::Release.
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+{
+    string filename = string(path);
+    filename = directory + '/' + filename;
 
-    return textureID;
+    return TextureCache::Instance().Acquire2D(filename);
 }
 #endif
@@ -0,0 +1,153 @@
+#ifndef OCCLUSION_QUERIES_H
+#define OCCLUSION_QUERIES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/gl_handle.h>
+#include <learnopengl/shader.h>
+
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// hardware occlusion culling with a frame of latency. every occludable object gets a query that draws its
+// world space bounding box against the depth buffer once the opaque scene is in it; the object's draws in the
+// next frame are wrapped in a conditional render on that query (GL_QUERY_NO_WAIT), so the GPU skips them if
+// no sample of the box passed and the CPU never waits for a result.
+// usage per frame: BeginFrame, Condition for every occludable object while recording, Issue after the occluders.
+class OcclusionQueries
+{
+public:
+    // boxShader draws the unit cube with a "model" uniform (occlusion_box.vs/fs); needs a current context
+    explicit OcclusionQueries(Shader &boxShader) : shader(&boxShader)
+    {
+        modelUniform = shader->Uniform("model");
+
+        const float corners[8 * 3] = {
+            -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   1.0f,  1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,
+            -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,   1.0f,  1.0f,  1.0f,  -1.0f,  1.0f,  1.0f
+        };
+        const unsigned char faces[36] = {
+            0, 1, 2, 2, 3, 0,   4, 6, 5, 6, 4, 7,   0, 4, 5, 5, 1, 0,
+            3, 2, 6, 6, 7, 3,   0, 3, 7, 7, 4, 0,   1, 5, 6, 6, 2, 1
+        };
+        boxVao = VertexArrayHandle::Create();
+        boxVertices = BufferHandle::Create();
+        boxIndices = BufferHandle::Create();
+        glBindVertexArray(boxVao.Get());
+        glBindBuffer(GL_ARRAY_BUFFER, boxVertices.Get());
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boxIndices.Get());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glBindVertexArray(0);
+    }
+
+    OcclusionQueries(const OcclusionQueries&) = delete;
+    OcclusionQueries& operator=(const OcclusionQueries&) = delete;
+
+    // with culling disabled Condition always returns 0 and nothing is queried
+    void SetEnabled(bool enable) { enabled = enable; }
+    bool Enabled() const { return enabled; }
+
+    // eye position and near plane distance of this frame: boxes the near plane could cut into are not
+    // trusted, the clipped box might be reported hidden while the object is right in front of the camera
+    void BeginFrame(const glm::vec3 &eye, float nearPlane)
+    {
+        eyePosition = eye;
+        eyeMargin = nearPlane * 2.0f;
+        frame++;
+        queryCount = 0;
+        conditionCount = 0;
+    }
+
+    // schedules a query of the world space box of object for this frame and returns the query its draws
+    // should be conditional on, or 0 to draw them unconditionally (first frame seen, culling off, eye inside)
+    GLuint Condition(const void *object, const BoundingVolume &worldBounds)
+    {
+        if(!enabled)
+            return 0;
+        Occludee &occludee = occludees[object];
+        if(!occludee.query)
+            occludee.query = QueryHandle::Create();
+        const bool answered = occludee.issuedFrame + 1 == frame;
+        if(occludee.issuedFrame != frame)
+        {
+            occludee.issuedFrame = frame;
+            pending.push_back(PendingBox{ occludee.query.Get(), worldBounds });
+        }
+
+        const glm::vec3 d = eyePosition - worldBounds.center;
+        const bool eyeInside = fabs(d.x) <= worldBounds.extents.x + eyeMargin && fabs(d.y) <= worldBounds.extents.y + eyeMargin
+                            && fabs(d.z) <= worldBounds.extents.z + eyeMargin;
+        if(!answered || eyeInside)
+            return 0;
+        conditionCount++;
+        return occludee.query.Get();
+    }
+
+    // draws the boxes scheduled this frame, each inside its query, with color and depth writes off.
+    // leaves the box program and VAO bound, cull face disabled and the depth function at GL_LESS.
+    void Issue()
+    {
+        if(pending.empty())
+            return;
+        shader->use();
+        glBindVertexArray(boxVao.Get());
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        glDisable(GL_CULL_FACE);
+        glDepthFunc(GL_LESS);
+        const GLenum target = GLExtensions::OcclusionQueryTarget();
+        for(const PendingBox &box : pending)
+        {
+            glm::mat4 model(1.0f);
+            model[0][0] = box.bounds.extents.x;
+            model[1][1] = box.bounds.extents.y;
+            model[2][2] = box.bounds.extents.z;
+            model[3] = glm::vec4(box.bounds.center, 1.0f);
+            shader->setMat4(modelUniform, model);
+            glBeginQuery(target, box.query);
+            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, 0);
+            glEndQuery(target);
+        }
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_TRUE);
+        glBindVertexArray(0);
+        queryCount = (unsigned int)pending.size();
+        pending.clear();
+    }
+
+    // queries issued and draws made conditional this frame
+    unsigned int QueryCount() const { return queryCount; }
+    unsigned int ConditionCount() const { return conditionCount; }
+
+private:
+    struct Occludee {
+        QueryHandle query;
+        unsigned int issuedFrame = 0;
+    };
+
+    struct PendingBox {
+        GLuint query;
+        BoundingVolume bounds;
+    };
+
+    Shader *shader;
+    UniformHandle modelUniform;
+    VertexArrayHandle boxVao;
+    BufferHandle boxVertices, boxIndices;
+    unordered_map<const void*, Occludee> occludees;
+    vector<PendingBox> pending;
+    bool enabled = false;
+    unsigned int frame = 1;
+    glm::vec3 eyePosition = glm::vec3(0.0f);
+    float eyeMargin = 0.0f;
+    unsigned int queryCount = 0, conditionCount = 0;
+};
+#endif
@@ -0,0 +1,174 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_extensions.h>
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// bump whenever the file layout changes
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+// header of a cached program binary, followed by length bytes of the binary
+struct ProgramCacheHeader {
+    char magic[4];          // "PBIN"
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;        // binary format reported by glGetProgramBinary
+    uint32_t length;
+};
+
+// linked programs saved with glGetProgramBinary and restored with glProgramBinary on the next launch, one file
+// per program named after its key. the key hashes the final stage sources (with the injected defines) and the
+// driver's vendor, renderer and version strings; a binary the driver refuses anyway (driver update, other GPU)
+// makes Load fail, the caller compiles from source and Store replaces the file.
+// without program binary support (GL 4.1 / ARB_get_program_binary) or a directory set it does nothing.
+class ProgramCache
+{
+public:
+    static ProgramCache &Instance()
+    {
+        static ProgramCache cache;
+        return cache;
+    }
+
+    ProgramCache(const ProgramCache&) = delete;
+    ProgramCache& operator=(const ProgramCache&) = delete;
+
+    // where the binaries go, created if missing; an empty path disables the cache. needs a current context
+    // and GLExtensions::Init
+    void SetDirectory(const string &path)
+    {
+        directory = path;
+        if(!directory.empty())
+            mkdir(directory.c_str(), 0755);
+        driverHash = FNV_OFFSET;
+        for(GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+        {
+            const char *value = (const char*)glGetString(name);
+            const string text = value ? value : "";
+            driverHash = fnv1a(text.data(), text.size() + 1, driverHash);
+        }
+    }
+
+    bool Enabled() const { return !directory.empty() && GLExtensions::ProgramBinaries(); }
+
+    // key of a program built from these stage sources (an empty geometry source for none)
+    uint64_t Key(const string &vertex, const string &fragment, const string &geometry) const
+    {
+        uint64_t hash = fnv1a((const char*)&PROGRAM_CACHE_VERSION, sizeof(PROGRAM_CACHE_VERSION), driverHash);
+        for(const string *source : { &vertex, &fragment, &geometry })
+            hash = fnv1a(source->c_str(), source->size() + 1, hash);
+        return hash;
+    }
+
+    // call before linking, so the driver keeps the binary around for Store
+    void PrepareLink(GLuint program) const
+    {
+        if(Enabled())
+            GLExtensions::ProgramParameteri()(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // restores the program from its cached binary; false (program left unlinked) if there is none or the
+    // driver rejected it
+    bool Load(GLuint program, uint64_t key) const
+    {
+        if(!Enabled())
+            return false;
+        ifstream in(PathFor(key), ios::binary | ios::ate);
+        if(!in)
+            return false;
+        const streamoff fileSize = in.tellg();
+        in.seekg(0);
+        ProgramCacheHeader header;
+        if(!in.read((char*)&header, sizeof(header)) || memcmp(header.magic, "PBIN", 4) != 0
+           || header.version != PROGRAM_CACHE_VERSION || header.key != key)
+            return false;
+        // a truncated or corrupt file must not make us allocate whatever its length field says
+        if(header.length == 0 || (streamoff)header.length != fileSize - (streamoff)sizeof(header))
+            return false;
+        vector<char> binary(header.length);
+        if(!in.read(binary.data(), binary.size()))
+            return false;
+
+        GLExtensions::ProgramBinary()(program, header.format, binary.data(), (GLsizei)binary.size());
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        return linked == GL_TRUE;
+    }
+
+    // saves the binary of a successfully linked program
+    void Store(GLuint program, uint64_t key) const
+    {
+        if(!Enabled())
+            return;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length <= 0)
+            return;
+        vector<char> binary(length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        GLExtensions::GetProgramBinary()(program, length, &written, &format, binary.data());
+        if(written <= 0)
+            return;
+
+        ProgramCacheHeader header;
+        memcpy(header.magic, "PBIN", 4);
+        header.version = PROGRAM_CACHE_VERSION;
+        header.key = key;
+        header.format = format;
+        header.length = (uint32_t)written;
+
+        const string path = PathFor(key);
+        const string tmpPath = path + ".tmp";
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        if(!out)
+            return;
+        out.write((const char*)&header, sizeof(header));
+        out.write(binary.data(), written);
+        out.close();
+        if(!out || rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            cout << "ERROR::PROGRAM_CACHE::WRITE_FAILED " << path << endl;
+            remove(tmpPath.c_str());
+        }
+    }
+
+    string PathFor(uint64_t key) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.progbin", (unsigned long long)key);
+        return directory + '/' + name;
+    }
+
+private:
+    ProgramCache() {}
+
+    string directory;
+    uint64_t driverHash = FNV_OFFSET;
+
+    static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+    static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+    static uint64_t fnv1a(const char *data, size_t size, uint64_t hash)
+    {
+        for(size_t i = 0; i < size; i++)
+        {
+            hash ^= (unsigned char)data[i];
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+};
+#endif
@@ -0,0 +1,707 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/gl_handle.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/occlusion_queries.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// passes are the most significant part of the sort key, so everything of one pass draws before the next
+enum RenderPass {
+    PASS_OPAQUE = 0,
+    PASS_SKYBOX,        // after the opaque geometry, depth tested with GL_LEQUAL
+    PASS_TRANSPARENT,
+    PASS_COUNT
+};
+
+const unsigned int RENDER_QUEUE_MAX_TEXTURES = 4;
+
+// the bits of fixed function state draws in this scene differ in; applied only when it changes
+struct RenderState {
+    bool cullFace = false;      // culls GL_FRONT with clockwise front faces, as the scene is set up
+    GLenum depthFunc = GL_LESS;
+    bool depthWrite = true;     // off for everything in PASS_TRANSPARENT
+
+    bool operator==(const RenderState &other) const
+    {
+        return cullFace == other.cullFace && depthFunc == other.depthFunc && depthWrite == other.depthWrite;
+    }
+    bool operator!=(const RenderState &other) const { return !(*this == other); }
+};
+
+struct TextureBinding {
+    GLenum target;
+    GLuint id;
+};
+
+// one recorded draw: either a Mesh (textures, samplers and index range come from it) or a raw
+// glDrawArrays on a VAO with explicitly listed textures
+struct DrawCommand {
+    Shader *shader = nullptr;
+    const Mesh *mesh = nullptr;
+    unsigned int lod = 0;
+    unsigned int instanceCount = 0;     // instanced mesh draw, the model matrices come from the instance buffer
+    GLuint instanceBuffer = 0;
+    GLuint vao = 0;
+    GLint first = 0;
+    GLsizei count = 0;
+    TextureBinding textures[RENDER_QUEUE_MAX_TEXTURES];
+    unsigned int textureCount = 0;
+    glm::mat4 model = glm::mat4(1.0f);
+    RenderState state;
+    GLuint condition = 0;               // occlusion query the draw is conditional on, 0 for none
+};
+
+// number of GL calls a submit issued (and how many draws it had), to see that sorting pays off
+struct RenderQueueStats {
+    unsigned int draws = 0;         // recorded commands
+    unsigned int drawCalls = 0;     // GL draw calls they were merged into
+    unsigned int programBinds = 0;
+    unsigned int vaoBinds = 0;
+    unsigned int textureBinds = 0;
+    unsigned int stateChanges = 0;
+    unsigned int drawnMeshes = 0;   // mesh draws (instances count once per mesh) that passed the frustum test
+    unsigned int culledMeshes = 0;  // and those that were dropped by it
+    unsigned int occlusionQueries = 0;  // bounding boxes queried for the next frame
+    unsigned int conditionalDraws = 0;  // draw calls wrapped in a conditional render on last frame's queries
+    unsigned int prepassDrawCalls = 0;  // draw calls of the depth pre-pass, not included in drawCalls
+};
+
+// collects a frame's draws, sorts them by a 64-bit key and submits them with redundant binds removed.
+// key layout, most significant first:
+//   opaque, skybox: pass (3 bits) | depth bucket (4) | program (11) | texture set (16) | VAO (16) | depth (14)
+//   transparent:    pass (3 bits) | inverted depth (18) | program (11) | texture set (16) | VAO (16)
+// opaque draws go roughly front to back, so early depth testing rejects what is hidden, while still being
+// grouped by state inside each bucket; transparent draws go strictly back to front for correct blending.
+// programs, texture sets and VAOs are interned to small ids in the order they are first seen.
+// per-frame uniforms (view, projection, lights) are set by the caller on each program before Submit;
+// the queue only sets the per-draw "model" matrix and the mesh samplers/dequantization.
+// consecutive mesh draws that differ in nothing but their index range (meshes sharing an arena page,
+// textures and transform) are merged into one glMultiDrawElementsIndirect, or glMultiDrawElementsBaseVertex
+// where multi-draw indirect is not available.
+// with a frustum set, mesh draws whose transformed bounds are outside of it are dropped before sorting.
+// with occlusion queries set, their boxes are drawn between the skybox and the transparent pass.
+// with the depth pre-pass enabled, opaque meshes whose shader has a depth-only variant (SetDepthPrepassShader)
+// first lay down depth with it, and the shaded pass then only runs the fragment shader for visible pixels.
+class RenderQueue
+{
+public:
+    RenderQueueStats stats;
+
+    // range the depth passed to Add is quantized over, typically the projection's near and far planes
+    void SetDepthRange(float nearPlane, float farPlane)
+    {
+        depthNear = nearPlane;
+        depthFar = farPlane;
+    }
+
+    // enables frustum culling of mesh draws against the planes of projection * view, set once per frame
+    void SetFrustum(const glm::mat4 &viewProjection)
+    {
+        frustum = Frustum::FromMatrix(viewProjection);
+        frustumSet = true;
+    }
+
+    // copies the matrices of the instances whose transformed bounds are inside the frustum to visible and
+    // returns how many there are; meshCount is only used for the stats. everything is visible without a frustum.
+    unsigned int CullInstances(const BoundingVolume &bounds, const glm::mat4 *models, unsigned int count, vector<glm::mat4> &visible, unsigned int meshCount = 1)
+    {
+        visible.clear();
+        if(!frustumSet)
+        {
+            visible.assign(models, models + count);
+            return count;
+        }
+        culler.Clear();
+        for(unsigned int i = 0; i < count; i++)
+            culler.Add(bounds, models[i]);
+        culler.Cull(frustum);
+        for(unsigned int i = 0; i < count; i++)
+        {
+            if(culler.Visible(i))
+                visible.push_back(models[i]);
+        }
+        pendingDrawn += (unsigned int)visible.size() * meshCount;
+        pendingCulled += (count - (unsigned int)visible.size()) * meshCount;
+        return (unsigned int)visible.size();
+    }
+
+    // occlusion culling for the draws recorded with a condition (see OcclusionCondition); null turns it off
+    void SetOcclusionQueries(OcclusionQueries *queries)
+    {
+        occlusion = queries;
+    }
+
+    // the condition to record an object's draws with, 0 (unconditional) without occlusion queries
+    GLuint OcclusionCondition(const void *object, const BoundingVolume &worldBounds)
+    {
+        return occlusion ? occlusion->Condition(object, worldBounds) : 0;
+    }
+
+    // depthShader: the vertex shader of shader (with invariant gl_Position) and an empty fragment shader
+    void SetDepthPrepassShader(Shader &shader, Shader &depthShader)
+    {
+        depthShaders[shader.ID] = &depthShader;
+    }
+
+    void EnableDepthPrepass(bool enable) { depthPrepass = enable; }
+
+    // view space distance of an object, the usual depth argument
+    static float ViewDepth(const glm::mat4 &view, const glm::mat4 &model)
+    {
+        return -(view * model[3]).z;
+    }
+
+    void Add(RenderPass pass, Shader &shader, const Mesh &mesh, unsigned int lod, const glm::mat4 &model, float depth, RenderState state = RenderState(),
+             GLuint condition = 0)
+    {
+        DrawCommand command;
+        command.shader = &shader;
+        command.mesh = &mesh;
+        command.lod = lod;
+        command.vao = mesh.VertexArray();
+        command.model = model;
+        command.state = state;
+        command.condition = condition;
+        textureSet.clear();
+        for(const Texture &texture : mesh.textures)
+            textureSet.push_back(texture.id);
+        push(classify(pass, mesh), command, depth);
+    }
+
+    // instanceCount copies of a mesh whose model matrices are in instanceBuffer (see Mesh::DrawInstanced);
+    // the shader has to be an instanced one
+    void AddInstanced(RenderPass pass, Shader &shader, const Mesh &mesh, unsigned int lod, GLuint instanceBuffer, unsigned int instanceCount,
+                      float depth, RenderState state = RenderState(), GLuint condition = 0)
+    {
+        DrawCommand command;
+        command.shader = &shader;
+        command.mesh = &mesh;
+        command.lod = lod;
+        command.instanceCount = instanceCount;
+        command.instanceBuffer = instanceBuffer;
+        command.vao = mesh.VertexArray();
+        command.state = state;
+        command.condition = condition;
+        textureSet.clear();
+        for(const Texture &texture : mesh.textures)
+            textureSet.push_back(texture.id);
+        push(classify(pass, mesh), command, depth);
+    }
+
+    void AddArrays(RenderPass pass, Shader &shader, GLuint vao, GLint first, GLsizei count, initializer_list<TextureBinding> textures,
+                   const glm::mat4 &model, float depth, RenderState state = RenderState())
+    {
+        DrawCommand command;
+        command.shader = &shader;
+        command.vao = vao;
+        command.first = first;
+        command.count = count;
+        for(const TextureBinding &texture : textures)
+        {
+            if(command.textureCount < RENDER_QUEUE_MAX_TEXTURES)
+                command.textures[command.textureCount++] = texture;
+        }
+        command.model = model;
+        command.state = state;
+        textureSet.clear();
+        for(unsigned int i = 0; i < command.textureCount; i++)
+            textureSet.push_back(command.textures[i].id);
+        push(pass, command, depth);
+    }
+
+    // sorts and issues everything recorded since the last submit, then empties the queue
+    void Submit()
+    {
+        stats = RenderQueueStats();
+        stats.drawnMeshes = pendingDrawn;
+        stats.culledMeshes = pendingCulled;
+        pendingDrawn = pendingCulled = 0;
+        cull();
+
+        sortEntries.resize(commands.size());
+        for(unsigned int i = 0; i < commands.size(); i++)
+            sortEntries[i] = SortEntry{ keys[i], i };
+        radixSort(sortEntries, sortScratch);
+
+        buildBatches();
+
+        // nothing is known about the GL state at the start of a submit
+        bound = BoundState();
+        applyState(bound.state);
+        assignedSamplers.clear();
+
+        if(depthPrepass && !depthShaders.empty())
+            drawDepthPrepass();
+
+        bool queriesIssued = false;
+        for(const Batch &batch : batches)
+        {
+            // the occlusion boxes test against the opaque scene only, transparent surfaces must not hide anything
+            if(!queriesIssued && passOf(batch) >= PASS_TRANSPARENT)
+            {
+                queriesIssued = true;
+                if(issueOcclusionQueries(bound.state))
+                    bound.program = bound.vao = 0;
+            }
+
+            // after the pre-pass the depth buffer already holds the final depth of these
+            const DrawCommand &command = commands[sortEntries[batch.first].index];
+            RenderState state = command.state;
+            if(prepassed(batch))
+            {
+                state.depthFunc = GL_LEQUAL;
+                state.depthWrite = false;
+            }
+            drawBatch(batch, *command.shader, state, true);
+            stats.draws += batch.count;
+            stats.drawCalls++;
+        }
+        if(!queriesIssued)
+            issueOcclusionQueries(bound.state);
+
+        if(indirectBound)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            indirectBound = false;
+        }
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+        applyState(RenderState());
+        commands.clear();
+        keys.clear();
+    }
+
+    unsigned int Size() const { return (unsigned int)commands.size(); }
+
+private:
+    struct SortEntry {
+        uint64_t key;
+        unsigned int index;
+    };
+
+    // a run of sorted commands drawn with one call; mesh runs have their commands at indirectFirst
+    struct Batch {
+        unsigned int first;
+        unsigned int count;
+        unsigned int indirectFirst;
+    };
+
+    vector<DrawCommand> commands;
+    vector<uint64_t> keys;
+    vector<Batch> batches;
+    vector<DrawElementsIndirectCommand> indirectCommands;
+    BufferHandle indirectBuffer;
+    bool indirectBound = false;
+    // glMultiDrawElementsBaseVertex arguments, when multi-draw indirect is not available
+    vector<GLsizei> multiCounts;
+    vector<const void*> multiOffsets;
+    vector<GLint> multiBaseVertices;
+    vector<SortEntry> sortEntries, sortScratch;
+    vector<GLuint> textureSet;
+    float depthNear = 0.1f, depthFar = 100.0f;
+    unordered_map<GLuint, Shader*> depthShaders;    // program -> its depth-only variant
+    bool depthPrepass = false;
+
+    // what the submit has bound so far
+    struct BoundState {
+        GLuint program = 0, vao = 0;
+        GLuint textures[RENDER_QUEUE_MAX_TEXTURES] = {0, 0, 0, 0};
+        GLenum targets[RENDER_QUEUE_MAX_TEXTURES] = {0, 0, 0, 0};
+        RenderState state;
+    };
+    BoundState bound;
+    OcclusionQueries *occlusion = nullptr;
+    Frustum frustum;
+    bool frustumSet = false;
+    FrustumCuller culler;
+    unsigned int pendingDrawn = 0, pendingCulled = 0;     // instances culled by CullInstances before the submit
+
+    unordered_map<GLuint, unsigned int> programIds;
+    unordered_map<GLuint, unsigned int> vaoIds;
+    struct TextureSetHash {
+        size_t operator()(const vector<GLuint> &set) const
+        {
+            size_t hash = set.size();
+            for(GLuint id : set)
+                hash ^= id + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+            return hash;
+        }
+    };
+    unordered_map<vector<GLuint>, unsigned int, TextureSetHash> textureSetIds;
+    struct ProgramUniforms {
+        UniformHandle model;
+        UniformHandle positionScale;
+        UniformHandle positionOffset;
+    };
+    unordered_map<GLuint, ProgramUniforms> programUniforms;
+    unordered_map<GLuint, unordered_map<string, GLint>> assignedSamplers;    // sampler -> unit, per program and submit
+
+    static const unsigned int PROGRAM_BITS = 11, TEXTURE_SET_BITS = 16, VAO_BITS = 16, DEPTH_BITS = 18, DEPTH_BUCKET_BITS = 4;
+    static const unsigned int PASS_SHIFT = PROGRAM_BITS + TEXTURE_SET_BITS + VAO_BITS + DEPTH_BITS;
+
+    template<typename Map, typename Key>
+    static unsigned int intern(Map &ids, const Key &key, unsigned int bits)
+    {
+        typename Map::iterator found = ids.find(key);
+        if(found != ids.end())
+            return found->second;
+        // running out of ids only costs sorting quality, never correctness
+        const unsigned int id = min((unsigned int)ids.size(), (1u << bits) - 1);
+        ids.emplace(key, id);
+        return id;
+    }
+
+    // meshes with a transparent material are blended after the opaque scene, whatever they were enqueued with
+    static RenderPass classify(RenderPass pass, const Mesh &mesh)
+    {
+        return pass == PASS_OPAQUE && mesh.transparent ? PASS_TRANSPARENT : pass;
+    }
+
+    void push(RenderPass pass, DrawCommand command, float depth)
+    {
+        const float normalized = min(max((depth - depthNear) / (depthFar - depthNear), 0.0f), 1.0f);
+        const uint64_t program = intern(programIds, command.shader->ID, PROGRAM_BITS);
+        const uint64_t textures = intern(textureSetIds, textureSet, TEXTURE_SET_BITS);
+        const uint64_t vao = intern(vaoIds, command.vao, VAO_BITS);
+        uint64_t key = (uint64_t)pass;
+        if(pass == PASS_TRANSPARENT)
+        {
+            // blended surfaces are sorted, they must not hide each other in the depth buffer
+            command.state.depthWrite = false;
+            key = (key << DEPTH_BITS) | (uint64_t)((1.0f - normalized) * ((1u << DEPTH_BITS) - 1));
+            key = (key << PROGRAM_BITS) | program;
+            key = (key << TEXTURE_SET_BITS) | textures;
+            key = (key << VAO_BITS) | vao;
+        }
+        else
+        {
+            // buckets widen with distance, where a few units make less of a difference in overdraw
+            const uint64_t bucket = min((uint64_t)(sqrt(normalized) * (1u << DEPTH_BUCKET_BITS)), (uint64_t)(1u << DEPTH_BUCKET_BITS) - 1);
+            key = (key << DEPTH_BUCKET_BITS) | bucket;
+            key = (key << PROGRAM_BITS) | program;
+            key = (key << TEXTURE_SET_BITS) | textures;
+            key = (key << VAO_BITS) | vao;
+            key = (key << (DEPTH_BITS - DEPTH_BUCKET_BITS)) | (uint64_t)(normalized * ((1u << (DEPTH_BITS - DEPTH_BUCKET_BITS)) - 1));
+        }
+        commands.push_back(command);
+        keys.push_back(key);
+    }
+
+    RenderPass passOf(const Batch &batch) const
+    {
+        return (RenderPass)(sortEntries[batch.first].key >> PASS_SHIFT);
+    }
+
+    // whether the batch's depth was already laid down by the pre-pass
+    bool prepassed(const Batch &batch) const
+    {
+        const DrawCommand &command = commands[sortEntries[batch.first].index];
+        return depthPrepass && command.mesh && passOf(batch) == PASS_OPAQUE && depthShaders.count(command.shader->ID) > 0;
+    }
+
+    // binds what the batch needs with shader and state and draws it. without material the textures and
+    // samplers are left alone, for shaders that don't read them
+    void drawBatch(const Batch &batch, Shader &shader, const RenderState &state, bool material)
+    {
+        const DrawCommand &command = commands[sortEntries[batch.first].index];
+        if(shader.ID != bound.program)
+        {
+            glUseProgram(shader.ID);
+            bound.program = shader.ID;
+            stats.programBinds++;
+        }
+        if(state != bound.state)
+        {
+            bound.state = state;
+            applyState(state);
+            stats.stateChanges++;
+        }
+
+        const ProgramUniforms &handles = uniforms(shader);
+        if(!command.instanceCount && handles.model.Valid())
+            shader.setMat4(handles.model, command.model);
+
+        // textures: unit i gets texture i, same as Mesh::Draw
+        const unsigned int textureCount = !material ? 0 : command.mesh ? min((unsigned int)command.mesh->textures.size(), RENDER_QUEUE_MAX_TEXTURES) : command.textureCount;
+        for(unsigned int i = 0; i < textureCount; i++)
+        {
+            const TextureBinding texture = command.mesh ? TextureBinding{ GL_TEXTURE_2D, command.mesh->textures[i].id } : command.textures[i];
+            if(bound.textures[i] != texture.id || bound.targets[i] != texture.target)
+            {
+                glActiveTexture(GL_TEXTURE0 + i);
+                glBindTexture(texture.target, texture.id);
+                bound.textures[i] = texture.id;
+                bound.targets[i] = texture.target;
+                stats.textureBinds++;
+            }
+        }
+
+        if(command.vao != bound.vao)
+        {
+            glBindVertexArray(command.vao);
+            bound.vao = command.vao;
+            stats.vaoBinds++;
+        }
+
+        if(command.condition)
+        {
+            glBeginConditionalRender(command.condition, GL_QUERY_NO_WAIT);
+            stats.conditionalDraws++;
+        }
+        if(command.mesh)
+        {
+            if(command.instanceCount)
+                command.mesh->AttachInstanceBuffer(command.instanceBuffer);
+            drawMeshes(batch, *command.mesh, shader, handles, material);
+        }
+        else
+            glDrawArrays(GL_TRIANGLES, command.first, command.count);
+        if(command.condition)
+            glEndConditionalRender();
+    }
+
+    // depth only draw of the opaque meshes that have a depth shader, color writes off
+    void drawDepthPrepass()
+    {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        for(const Batch &batch : batches)
+        {
+            if(passOf(batch) != PASS_OPAQUE)
+                break;
+            if(!prepassed(batch))
+                continue;
+            const DrawCommand &command = commands[sortEntries[batch.first].index];
+            drawBatch(batch, *depthShaders[command.shader->ID], command.state, false);
+            stats.prepassDrawCalls++;
+        }
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+
+    // drops the mesh draws outside of the frustum, one batch test over all of them. instanced draws were
+    // already culled per instance (CullInstances) and draws without a mesh have no bounds, both are kept.
+    void cull()
+    {
+        if(!frustumSet)
+            return;
+        culler.Clear();
+        for(const DrawCommand &command : commands)
+        {
+            if(command.mesh && !command.instanceCount)
+                culler.Add(command.mesh->bounds, command.model);
+        }
+        if(culler.Size() == 0)
+            return;
+        culler.Cull(frustum);
+
+        unsigned int kept = 0, tested = 0;
+        for(unsigned int i = 0; i < commands.size(); i++)
+        {
+            if(commands[i].mesh && !commands[i].instanceCount)
+            {
+                if(!culler.Visible(tested++))
+                {
+                    stats.culledMeshes++;
+                    continue;
+                }
+                stats.drawnMeshes++;
+            }
+            commands[kept] = commands[i];
+            keys[kept] = keys[i];
+            kept++;
+        }
+        commands.resize(kept);
+        keys.resize(kept);
+    }
+
+    // handles of the uniforms the queue sets itself, resolved the first time a program is submitted
+    const ProgramUniforms &uniforms(const Shader &shader)
+    {
+        unordered_map<GLuint, ProgramUniforms>::iterator found = programUniforms.find(shader.ID);
+        if(found != programUniforms.end())
+            return found->second;
+        ProgramUniforms handles;
+        handles.model = shader.Uniform("model");
+        handles.positionScale = shader.Uniform("positionScale");
+        handles.positionOffset = shader.Uniform("positionOffset");
+        return programUniforms.emplace(shader.ID, handles).first->second;
+    }
+
+    // whether b can be drawn in the same multi-draw as a: same program, state, VAO, textures and per-draw
+    // uniforms, so only the index range differs
+    static bool mergeable(const DrawCommand &a, const DrawCommand &b)
+    {
+        if(!a.mesh || !b.mesh || a.shader != b.shader || a.state != b.state || a.vao != b.vao || a.mesh->indexType != b.mesh->indexType)
+            return false;
+        if(a.instanceCount != b.instanceCount || a.instanceBuffer != b.instanceBuffer || a.condition != b.condition)
+            return false;
+        if(!a.instanceCount && a.model != b.model)
+            return false;
+        if(a.mesh->layout.positionScale != b.mesh->layout.positionScale || a.mesh->layout.positionOffset != b.mesh->layout.positionOffset)
+            return false;
+        const vector<Texture> &ta = a.mesh->textures, &tb = b.mesh->textures;
+        if(ta.size() != tb.size())
+            return false;
+        for(unsigned int i = 0; i < ta.size(); i++)
+        {
+            if(ta[i].id != tb[i].id || ta[i].type != tb[i].type)
+                return false;
+        }
+        return true;
+    }
+
+    // groups the sorted commands into batches and writes the frame's indirect commands
+    void buildBatches()
+    {
+        batches.clear();
+        indirectCommands.clear();
+        for(unsigned int i = 0; i < sortEntries.size(); i++)
+        {
+            const DrawCommand &command = commands[sortEntries[i].index];
+            if(!batches.empty() && mergeable(commands[sortEntries[batches.back().first].index], command))
+                batches.back().count++;
+            else
+                batches.push_back(Batch{ i, 1, (unsigned int)indirectCommands.size() });
+            if(command.mesh)
+            {
+                const MeshLod &range = command.mesh->lods[min(command.lod, (unsigned int)command.mesh->lods.size() - 1)];
+                indirectCommands.push_back(DrawElementsIndirectCommand{ range.indexCount, max(command.instanceCount, 1u),
+                                                                        command.mesh->FirstIndex(range), command.mesh->BaseVertex(), 0 });
+            }
+        }
+
+        // one upload of the whole frame's commands, orphaning last frame's
+        if(GLExtensions::MultiDrawElementsIndirect() && !indirectCommands.empty())
+        {
+            if(!indirectBuffer)
+                indirectBuffer = BufferHandle::Create();
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer.Get());
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, indirectCommands.size() * sizeof(DrawElementsIndirectCommand), indirectCommands.data(), GL_STREAM_DRAW);
+            indirectBound = true;
+        }
+    }
+
+    // draws a batch of mesh commands; the material and uniforms are the same for all, so the first sets them
+    void drawMeshes(const Batch &batch, const Mesh &mesh, const Shader &shader, const ProgramUniforms &handles, bool material)
+    {
+        // sampler uniforms only change when a mesh maps a name to another unit than the last one did.
+        // sampler names depend on the mesh, so these go through the shader's name table
+        const vector<string> &samplers = mesh.SamplerNames();
+        unordered_map<string, GLint> &assigned = assignedSamplers[shader.ID];
+        for(unsigned int i = 0; material && i < samplers.size() && i < RENDER_QUEUE_MAX_TEXTURES; i++)
+        {
+            unordered_map<string, GLint>::iterator found = assigned.find(samplers[i]);
+            if(found != assigned.end() && found->second == (GLint)i)
+                continue;
+            shader.setInt(samplers[i], i);
+            assigned[samplers[i]] = i;
+        }
+
+        if(handles.positionScale.Valid())
+        {
+            shader.setVec3(handles.positionScale, mesh.layout.positionScale);
+            shader.setVec3(handles.positionOffset, mesh.layout.positionOffset);
+        }
+
+        const DrawElementsIndirectCommand *draws = &indirectCommands[batch.indirectFirst];
+        const size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        if(batch.count > 1 && indirectBound)
+        {
+            GLExtensions::MultiDrawElementsIndirect()(GL_TRIANGLES, mesh.indexType,
+                (const void*)(batch.indirectFirst * sizeof(DrawElementsIndirectCommand)), batch.count, 0);
+        }
+        else if(batch.count > 1 && draws[0].instanceCount == 1)
+        {
+            multiCounts.resize(batch.count);
+            multiOffsets.resize(batch.count);
+            multiBaseVertices.resize(batch.count);
+            for(unsigned int i = 0; i < batch.count; i++)
+            {
+                multiCounts[i] = draws[i].count;
+                multiOffsets[i] = (const void*)(draws[i].firstIndex * indexSize);
+                multiBaseVertices[i] = draws[i].baseVertex;
+            }
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, multiCounts.data(), mesh.indexType, (const void* const*)multiOffsets.data(),
+                                          batch.count, multiBaseVertices.data());
+        }
+        else
+        {
+            // single draws, and instanced batches without indirect support
+            for(unsigned int i = 0; i < batch.count; i++)
+            {
+                const DrawElementsIndirectCommand &draw = draws[i];
+                const void *offset = (const void*)(draw.firstIndex * indexSize);
+                if(commands[sortEntries[batch.first + i].index].instanceCount)
+                    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, draw.count, mesh.indexType, offset, draw.instanceCount, draw.baseVertex);
+                else
+                    glDrawElementsBaseVertex(GL_TRIANGLES, draw.count, mesh.indexType, offset, draw.baseVertex);
+            }
+        }
+    }
+
+    // draws this frame's occlusion boxes and puts back the fixed function state the submit is in.
+    // returns whether the bound program and VAO were changed
+    bool issueOcclusionQueries(const RenderState &state)
+    {
+        if(!occlusion)
+            return false;
+        occlusion->Issue();
+        stats.occlusionQueries = occlusion->QueryCount();
+        applyState(state);
+        return true;
+    }
+
+    static void applyState(const RenderState &state)
+    {
+        if(state.cullFace)
+        {
+            glEnable(GL_CULL_FACE);
+            glCullFace(GL_FRONT);
+            glFrontFace(GL_CW);
+        }
+        else
+            glDisable(GL_CULL_FACE);
+        glDepthFunc(state.depthFunc);
+        glDepthMask(state.depthWrite ? GL_TRUE : GL_FALSE);
+    }
+
+    // LSD radix sort over the 8 bytes of the key; bytes that are equal across all keys are skipped
+    static void radixSort(vector<SortEntry> &entries, vector<SortEntry> &scratch)
+    {
+        scratch.resize(entries.size());
+        for(unsigned int shift = 0; shift < 64; shift += 8)
+        {
+            size_t counts[256] = {0};
+            for(const SortEntry &entry : entries)
+                counts[(entry.key >> shift) & 0xFF]++;
+            if(counts[(entries.empty() ? 0 : entries[0].key >> shift) & 0xFF] == entries.size())
+                continue;
+            size_t offset = 0;
+            for(unsigned int bucket = 0; bucket < 256; bucket++)
+            {
+                const size_t count = counts[bucket];
+                counts[bucket] = offset;
+                offset += count;
+            }
+            for(const SortEntry &entry : entries)
+                scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+            entries.swap(scratch);
+        }
+    }
+};
+#endif
@@ -0,0 +1,206 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_handle.h>
+
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <vector>
+using namespace std;
+
+// lower bound of the dynamic render scale; below this the upscale gets too blurry to be worth it
+const float RENDER_SCALE_MIN = 0.5f;
+// the scale only changes in steps of this size, so small frame time noise doesn't move it every frame
+const float RENDER_SCALE_STEP = 0.05f;
+
+// framebuffer with floating point (or any) color textures and an optional depth-stencil renderbuffer.
+// attachments are allocated at the full size; scaled targets render into the lower left Active part only,
+// so a render scale change never reallocates and the result is sampled with UvScale.
+class RenderTarget
+{
+public:
+    RenderTarget(initializer_list<GLenum> formats, bool depthStencil, bool scaledTarget, unsigned int downscaleShift)
+        : colorFormats(formats), hasDepthStencil(depthStencil), scaled(scaledTarget), downscale(downscaleShift)
+    {
+        framebuffer = FramebufferHandle::Create();
+    }
+
+    // (re)allocates the attachments when the size changes
+    void Resize(int newWidth, int newHeight)
+    {
+        if(newWidth == width && newHeight == height)
+            return;
+        width = newWidth;
+        height = newHeight;
+        activeWidth = min(activeWidth, width);
+        activeHeight = min(activeHeight, height);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.Get());
+        colors.resize(colorFormats.size());
+        vector<GLenum> drawBuffers;
+        for(unsigned int i = 0; i < colorFormats.size(); i++)
+        {
+            // a new texture rather than respecifying the old one, which may still be read by queued commands
+            colors[i] = TextureHandle::Create();
+            glBindTexture(GL_TEXTURE_2D, colors[i].Get());
+            glTexImage2D(GL_TEXTURE_2D, 0, colorFormats[i], width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colors[i].Get(), 0);
+            drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        if(hasDepthStencil)
+        {
+            depthStencil = RenderbufferHandle::Create();
+            glBindRenderbuffer(GL_RENDERBUFFER, depthStencil.Get());
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencil.Get());
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        }
+        glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::FRAMEBUFFER::NOT_COMPLETE " << width << "x" << height << endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // binds the framebuffer with the viewport on the active area
+    void Bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.Get());
+        glViewport(0, 0, activeWidth, activeHeight);
+    }
+
+    void SetActiveSize(int w, int h)
+    {
+        activeWidth = min(w, width);
+        activeHeight = min(h, height);
+    }
+
+    GLuint Framebuffer() const { return framebuffer.Get(); }
+    GLuint Color(unsigned int attachment) const { return colors[attachment].Get(); }
+    int Width() const { return width; }
+    int Height() const { return height; }
+    int ActiveWidth() const { return activeWidth; }
+    int ActiveHeight() const { return activeHeight; }
+    bool Scaled() const { return scaled; }
+    unsigned int Downscale() const { return downscale; }
+
+    // texture coordinate of the upper right corner of the active area
+    glm::vec2 UvScale() const
+    {
+        return width > 0 && height > 0 ? glm::vec2((float)activeWidth / width, (float)activeHeight / height) : glm::vec2(1.0f);
+    }
+
+private:
+    vector<GLenum> colorFormats;
+    bool hasDepthStencil;
+    bool scaled;
+    unsigned int downscale;
+    FramebufferHandle framebuffer;
+    vector<TextureHandle> colors;
+    RenderbufferHandle depthStencil;
+    int width = 0, height = 0;
+    int activeWidth = 0, activeHeight = 0;
+};
+
+// owns the off-screen targets and keeps them at the size of the window's framebuffer. scaled targets
+// (the scene) render at RenderScale of it; with dynamic resolution the scale follows the measured GPU
+// frame time to stay within a budget, and the screen pass upscales the result.
+class RenderTargets
+{
+public:
+    // scaled: rendered at the render scale instead of the output size.
+    // downscale: the target is the output size halved this many times (mip chains, half resolution effects)
+    RenderTarget &Add(initializer_list<GLenum> colorFormats, bool depthStencil, bool scaled = true, unsigned int downscale = 0)
+    {
+        targets.push_back(unique_ptr<RenderTarget>(new RenderTarget(colorFormats, depthStencil, scaled, downscale)));
+        RenderTarget &target = *targets.back();
+        if(outputWidth > 0 && outputHeight > 0)
+        {
+            target.Resize(shifted(outputWidth, downscale), shifted(outputHeight, downscale));
+            target.SetActiveSize(activeSize(target.Width(), scaled), activeSize(target.Height(), scaled));
+        }
+        return target;
+    }
+
+    // size of the default framebuffer, in pixels (not screen coordinates, which differ on HiDPI displays).
+    // a minimized window reports 0x0 and keeps the old targets.
+    void SetOutputSize(int width, int height)
+    {
+        if(width <= 0 || height <= 0)
+            return;
+        outputWidth = width;
+        outputHeight = height;
+        for(const unique_ptr<RenderTarget> &target : targets)
+            target->Resize(shifted(width, target->Downscale()), shifted(height, target->Downscale()));
+        applyScale();
+    }
+
+    int OutputWidth() const { return outputWidth; }
+    int OutputHeight() const { return outputHeight; }
+
+    void SetDynamicResolution(bool enable, float gpuBudgetMilliseconds)
+    {
+        dynamic = enable;
+        budget = gpuBudgetMilliseconds;
+        if(!dynamic && renderScale != 1.0f)
+        {
+            renderScale = 1.0f;
+            applyScale();
+        }
+    }
+
+    // feeds a new GPU frame time; the pixel count, which is what the GPU time mostly scales with, is moved
+    // towards what would fit the budget, with headroom so the scale doesn't oscillate around it
+    void UpdateScale(float gpuMilliseconds)
+    {
+        if(!dynamic || gpuMilliseconds <= 0.0f)
+            return;
+        float wanted = renderScale;
+        if(gpuMilliseconds > budget)
+            wanted = renderScale * sqrt(budget / gpuMilliseconds);
+        else if(gpuMilliseconds < budget * 0.8f)
+            wanted = renderScale * sqrt(budget * 0.9f / gpuMilliseconds);
+        wanted = min(max(round(wanted / RENDER_SCALE_STEP) * RENDER_SCALE_STEP, RENDER_SCALE_MIN), 1.0f);
+        if(wanted != renderScale)
+        {
+            renderScale = wanted;
+            applyScale();
+        }
+    }
+
+    float RenderScale() const { return renderScale; }
+
+private:
+    vector<unique_ptr<RenderTarget>> targets;
+    int outputWidth = 0, outputHeight = 0;
+    bool dynamic = false;
+    float budget = 16.0f;
+    float renderScale = 1.0f;
+
+    static int shifted(int size, unsigned int shift)
+    {
+        return max(1, size >> shift);
+    }
+
+    int activeSize(int size, bool scaled) const
+    {
+        return scaled ? max(1, (int)ceil(size * renderScale)) : size;
+    }
+
+    void applyScale()
+    {
+        for(const unique_ptr<RenderTarget> &target : targets)
+            target->SetActiveSize(activeSize(target->Width(), target->Scaled()), activeSize(target->Height(), target->Scaled()));
+    }
+};
+#endif
@@ -0,0 +1,133 @@
+#ifndef RESOURCE_CACHE_H
+#define RESOURCE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_handle.h>
+#include <learnopengl/texture_loader.h>
+
+#include <climits>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// identifies a texture by what ends up in VRAM: the canonical file path(s) plus the parameters
+// that change the GL object, so two requests only share a texture if they would create the same one.
+struct TextureKey {
+    string path;            // canonical path, cubemap faces are joined with '\n'
+    GLenum target;
+    bool clampTransparent;
+
+    bool operator==(const TextureKey &other) const
+    {
+        return target == other.target && clampTransparent == other.clampTransparent && path == other.path;
+    }
+};
+
+struct TextureKeyHash {
+    size_t operator()(const TextureKey &key) const
+    {
+        size_t hash = std::hash<string>()(key.path);
+        hash ^= std::hash<unsigned int>()(key.target) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        hash ^= std::hash<bool>()(key.clampTransparent) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        return hash;
+    }
+};
+
+// process-wide, reference counted texture cache shared by the models and the loose textures in main.
+// every image is decoded and resident in VRAM once, no matter how many users acquire it.
+class TextureCache
+{
+public:
+    static TextureCache &Instance()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    unsigned int Acquire2D(const string &path, bool clampTransparent = false)
+    {
+        TextureKey key = { canonicalPath(path), GL_TEXTURE_2D, clampTransparent };
+        return acquire(key, [&] { return TextureLoader::Instance().Load2D(path, clampTransparent); });
+    }
+
+    unsigned int AcquireCubemap(const vector<string> &faces)
+    {
+        string joined;
+        for(const string &face : faces)
+            joined += canonicalPath(face) + '\n';
+        TextureKey key = { joined, GL_TEXTURE_CUBE_MAP, false };
+        return acquire(key, [&] { return TextureLoader::Instance().LoadCubemap(faces); });
+    }
+
+    // drops one reference, the texture is deleted with the last one
+    void Release(unsigned int textureID)
+    {
+        unordered_map<unsigned int, TextureKey>::iterator owner = keys.find(textureID);
+        if(owner == keys.end())
+            return;
+        unordered_map<TextureKey, Entry, TextureKeyHash>::iterator entry = entries.find(owner->second);
+        if(--entry->second.references > 0)
+            return;
+        TextureLoader::Instance().Cancel(textureID);
+        entries.erase(entry);   // deletes the texture
+        keys.erase(owner);
+    }
+
+    // deletes whatever is still cached; must run while the context is alive. later releases find nothing to do.
+    void Shutdown()
+    {
+        keys.clear();
+        entries.clear();
+    }
+
+    unsigned int Size() const { return (unsigned int)entries.size(); }
+
+    // number of acquires that were served without loading anything
+    unsigned int Hits() const { return hits; }
+
+private:
+    struct Entry {
+        TextureHandle texture;
+        unsigned int references;
+    };
+
+    unordered_map<TextureKey, Entry, TextureKeyHash> entries;
+    unordered_map<unsigned int, TextureKey> keys;    // reverse lookup for Release
+    unsigned int hits = 0;
+
+    TextureCache() {}
+
+    template<typename Load>
+    unsigned int acquire(const TextureKey &key, Load load)
+    {
+        unordered_map<TextureKey, Entry, TextureKeyHash>::iterator cached = entries.find(key);
+        if(cached != entries.end())
+        {
+            cached->second.references++;
+            hits++;
+            return cached->second.texture.Get();
+        }
+        Entry entry = { TextureHandle(load()), 1 };
+        const unsigned int id = entry.texture.Get();
+        entries.emplace(key, std::move(entry));
+        keys.emplace(id, key);
+        return id;
+    }
+
+    // resolves ".", ".." and symlinks so that relative and absolute spellings of a file share one entry
+    static string canonicalPath(const string &path)
+    {
+        char resolved[PATH_MAX];
+        if(realpath(path.c_str(), resolved))
+            return string(resolved);
+        return path;    // missing file, still cache the failed load under its literal name
+    }
+};
+#endif
@@ -0,0 +1,261 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <learnopengl/model.h>
+#include <learnopengl/render_queue.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SCENE_SSE 1
+#endif
+
+typedef unsigned int Entity;
+
+// edge of the world space grid cells copies of a model are batched in: copies further apart than this rarely
+// share a level of detail or a depth, and an instanced draw spanning the whole scene could never be occluded
+const float SCENE_CLUSTER_SIZE = 8.0f;
+
+// transforms of everything placed in the world, stored as structure of arrays (position, rotation quaternion,
+// scale) next to the world matrices built from them. static entities get their matrix rebuilt only after a
+// Set* call, dynamic ones (expected to move every frame) on every update without tracking. matrices are
+// built four at a time; the arrays are padded to a multiple of four with identity transforms for that.
+class Scene
+{
+public:
+    // model may be null for entities that are drawn by hand and only need a world matrix
+    Entity Add(Model *model, const glm::vec3 &position, const glm::quat &rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+               const glm::vec3 &scale = glm::vec3(1.0f), bool dynamic = false)
+    {
+        const Entity entity = count++;
+        if(entity == px.size())
+            grow();
+        models[entity] = model;
+        dynamicFlags[entity] = dynamic ? 1 : 0;
+        SetPosition(entity, position);
+        SetRotation(entity, rotation);
+        SetScale(entity, scale);
+        return entity;
+    }
+
+    void SetPosition(Entity entity, const glm::vec3 &position)
+    {
+        px[entity] = position.x;
+        py[entity] = position.y;
+        pz[entity] = position.z;
+        dirty[entity] = 1;
+    }
+
+    void SetRotation(Entity entity, const glm::quat &rotation)
+    {
+        rx[entity] = rotation.x;
+        ry[entity] = rotation.y;
+        rz[entity] = rotation.z;
+        rw[entity] = rotation.w;
+        dirty[entity] = 1;
+    }
+
+    void SetScale(Entity entity, const glm::vec3 &scale)
+    {
+        sx[entity] = scale.x;
+        sy[entity] = scale.y;
+        sz[entity] = scale.z;
+        dirty[entity] = 1;
+    }
+
+    glm::vec3 Position(Entity entity) const { return glm::vec3(px[entity], py[entity], pz[entity]); }
+    bool Dynamic(Entity entity) const { return dynamicFlags[entity] != 0; }
+    Model *ModelOf(Entity entity) const { return models[entity]; }
+    unsigned int Size() const { return count; }
+
+    // valid after UpdateWorldMatrices
+    const glm::mat4 &World(Entity entity) const { return world[entity]; }
+    const glm::mat4 *WorldMatrices() const { return world.data(); }
+
+    // rebuilds the matrices of the dirty and dynamic entities, skipping blocks of four without any.
+    // returns how many entities were updated
+    unsigned int UpdateWorldMatrices()
+    {
+        unsigned int updated = 0;
+        for(Entity block = 0; block < count; block += 4)
+        {
+            unsigned int changed = 0;
+            for(unsigned int lane = 0; lane < 4; lane++)
+                changed += dirty[block + lane] | dynamicFlags[block + lane];
+            if(!changed)
+                continue;
+            buildBlock(block);
+            for(unsigned int lane = 0; lane < 4; lane++)
+                dirty[block + lane] = 0;
+            updated += changed;
+        }
+        return updated;
+    }
+
+    // records every entity with a model. the copies of a model are batched by the SCENE_CLUSTER_SIZE cell they
+    // are in and the level of detail they ask for; a batch of one is enqueued with shader, a larger one as one
+    // instanced draw with instancedShader. each batch is sorted by the depth of its nearest copy and has its own
+    // occlusion query around its copies.
+    void Enqueue(RenderQueue &queue, RenderPass pass, Shader &shader, Shader &instancedShader,
+                 const glm::mat4 &view, const glm::mat4 &projection, float viewportHeight)
+    {
+        for(unique_ptr<ModelBatch> &batch : batches)
+            batch->instances.clear();
+        for(Entity entity = 0; entity < count; entity++)
+        {
+            Model *model = models[entity];
+            if(!model)
+                continue;
+            BatchKey key;
+            key.model = model;
+            key.level = model->SelectLod(world[entity], view, projection, viewportHeight, lodStates[entity]);
+            key.cell[0] = (int)floor(px[entity] / SCENE_CLUSTER_SIZE);
+            key.cell[1] = (int)floor(py[entity] / SCENE_CLUSTER_SIZE);
+            key.cell[2] = (int)floor(pz[entity] / SCENE_CLUSTER_SIZE);
+            unordered_map<BatchKey, unsigned int, BatchKeyHash>::iterator found = batchIndex.find(key);
+            if(found == batchIndex.end())
+            {
+                found = batchIndex.emplace(key, (unsigned int)batches.size()).first;
+                batches.push_back(unique_ptr<ModelBatch>(new ModelBatch));
+                batches.back()->model = model;
+                batches.back()->level = key.level;
+            }
+            ModelBatch &batch = *batches[found->second];
+            const float depth = RenderQueue::ViewDepth(view, world[entity]);
+            if(batch.instances.empty() || depth < batch.depth)
+                batch.depth = depth;
+            batch.instances.push_back(world[entity]);
+        }
+
+        for(unique_ptr<ModelBatch> &batch : batches)
+        {
+            if(batch->instances.size() == 1)
+                batch->model->Enqueue(queue, pass, shader, batch->instances[0], batch->level, batch->depth, batch.get());
+            else if(batch->instances.size() > 1)
+                batch->model->EnqueueInstanced(queue, pass, instancedShader, batch->instances.data(), (unsigned int)batch->instances.size(),
+                                               batch->level, batch->depth, batch->instanceBuffer, batch.get());
+        }
+    }
+
+private:
+    unsigned int count = 0;
+    vector<float> px, py, pz;
+    vector<float> rx, ry, rz, rw;
+    vector<float> sx, sy, sz;
+    vector<unsigned char> dynamicFlags, dirty;
+    vector<glm::mat4> world;
+    vector<Model*> models;
+    vector<LodState> lodStates;     // level of detail of every entity, kept across frames for the hysteresis
+
+    // copies of a model in one cluster cell at one level of detail
+    struct BatchKey {
+        Model *model;
+        unsigned int level;
+        int cell[3];
+
+        bool operator==(const BatchKey &other) const
+        {
+            return model == other.model && level == other.level && cell[0] == other.cell[0] && cell[1] == other.cell[1]
+                && cell[2] == other.cell[2];
+        }
+    };
+    struct BatchKeyHash {
+        size_t operator()(const BatchKey &key) const
+        {
+            size_t hash = std::hash<Model*>()(key.model);
+            for(int value : { (int)key.level, key.cell[0], key.cell[1], key.cell[2] })
+                hash ^= (size_t)value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+            return hash;
+        }
+    };
+
+    // the copies of one batch recorded by the last Enqueue. batches are kept once created, so every batch
+    // enqueued in a frame has its own instance buffer
+    struct ModelBatch {
+        Model *model = nullptr;
+        unsigned int level = 0;
+        vector<glm::mat4> instances;
+        float depth = 0.0f;
+        BufferHandle instanceBuffer;
+    };
+    vector<unique_ptr<ModelBatch>> batches;
+    unordered_map<BatchKey, unsigned int, BatchKeyHash> batchIndex;
+
+    // adds a block of four identity transforms
+    void grow()
+    {
+        const size_t size = px.size() + 4;
+        for(vector<float> *lane : { &px, &py, &pz, &rx, &ry, &rz, &sx, &sy, &sz, &rw })
+            lane->resize(size, 0.0f);
+        for(size_t i = size - 4; i < size; i++)
+            rw[i] = sx[i] = sy[i] = sz[i] = 1.0f;
+        dynamicFlags.resize(size, 0);
+        dirty.resize(size, 0);
+        world.resize(size, glm::mat4(1.0f));
+        models.resize(size, nullptr);
+        lodStates.resize(size);
+    }
+
+    // world = translate * rotate * scale of the four entities starting at first
+    void buildBlock(Entity first)
+    {
+#ifdef SCENE_SSE
+        const __m128 x = _mm_loadu_ps(&rx[first]), y = _mm_loadu_ps(&ry[first]), z = _mm_loadu_ps(&rz[first]), w = _mm_loadu_ps(&rw[first]);
+        const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+        const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+        const __m128 scaleX = _mm_loadu_ps(&sx[first]), scaleY = _mm_loadu_ps(&sy[first]), scaleZ = _mm_loadu_ps(&sz[first]);
+
+        // one register per matrix element, lane i belongs to entity first + i
+        __m128 c0x = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scaleX);
+        __m128 c0y = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scaleX);
+        __m128 c0z = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scaleX);
+        __m128 c0w = zero;
+        __m128 c1x = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scaleY);
+        __m128 c1y = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scaleY);
+        __m128 c1z = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scaleY);
+        __m128 c1w = zero;
+        __m128 c2x = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scaleZ);
+        __m128 c2y = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scaleZ);
+        __m128 c2z = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scaleZ);
+        __m128 c2w = zero;
+        __m128 c3x = _mm_loadu_ps(&px[first]), c3y = _mm_loadu_ps(&py[first]), c3z = _mm_loadu_ps(&pz[first]);
+        __m128 c3w = one;
+
+        // transposed, each register holds one column of one entity
+        _MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+        _MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+        _MM_TRANSPOSE4_PS(c2x, c2y, c2z, c2w);
+        _MM_TRANSPOSE4_PS(c3x, c3y, c3z, c3w);
+        const __m128 columns[4][4] = {
+            { c0x, c1x, c2x, c3x }, { c0y, c1y, c2y, c3y }, { c0z, c1z, c2z, c3z }, { c0w, c1w, c2w, c3w }
+        };
+        for(unsigned int lane = 0; lane < 4; lane++)
+        {
+            for(unsigned int column = 0; column < 4; column++)
+                _mm_storeu_ps(&world[first + lane][column].x, columns[lane][column]);
+        }
+#else
+        for(Entity entity = first; entity < first + 4; entity++)
+        {
+            const float x = rx[entity], y = ry[entity], z = rz[entity], w = rw[entity];
+            glm::mat4 &m = world[entity];
+            m[0] = glm::vec4((1.0f - 2.0f * (y * y + z * z)) * sx[entity], 2.0f * (x * y + w * z) * sx[entity], 2.0f * (x * z - w * y) * sx[entity], 0.0f);
+            m[1] = glm::vec4(2.0f * (x * y - w * z) * sy[entity], (1.0f - 2.0f * (x * x + z * z)) * sy[entity], 2.0f * (y * z + w * x) * sy[entity], 0.0f);
+            m[2] = glm::vec4(2.0f * (x * z + w * y) * sz[entity], 2.0f * (y * z - w * x) * sz[entity], (1.0f - 2.0f * (x * x + y * y)) * sz[entity], 0.0f);
+            m[3] = glm::vec4(px[entity], py[entity], pz[entity], 1.0f);
+        }
+#endif
+    }
+};
+#endif
@@ -0,0 +1,148 @@
+#ifndef SEPARABLE_FILTER_H
+#define SEPARABLE_FILTER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_handle.h>
+#include <learnopengl/render_target.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+enum FilterKernel {
+    FILTER_GAUSSIAN = 0,    // sigma of a third of the radius, the tails past it are negligible
+    FILTER_BOX,
+    FILTER_KERNEL_COUNT
+};
+
+const char *const FILTER_KERNEL_NAMES[FILTER_KERNEL_COUNT] = { "Gaussian", "Box" };
+
+const unsigned int FILTER_MAX_RADIUS = 32;
+// taps per side of a pass: the center and one bilinear fetch per pair of texels, MAX_TAPS in separable_filter.fs
+const unsigned int FILTER_MAX_TAPS = FILTER_MAX_RADIUS / 2 + 1;
+
+// one dimension of a symmetric kernel folded into bilinear taps: texels i and i + 1 with weights a and b are
+// read by a single fetch at i + b / (a + b) weighted a + b, so a radius r needs 1 + ceil(r / 2) taps per side
+struct FilterTaps {
+    float offsets[FILTER_MAX_TAPS] = {};    // in texels from the center
+    float weights[FILTER_MAX_TAPS] = {};    // the center one counts once, the others on both sides
+    unsigned int count = 0;
+
+    static FilterTaps Build(FilterKernel kernel, unsigned int radius)
+    {
+        radius = min(radius, FILTER_MAX_RADIUS);
+        vector<float> texelWeights(radius + 1);
+        const float sigma = max(radius / 3.0f, 0.5f);
+        float sum = 0.0f;
+        for(unsigned int i = 0; i <= radius; i++)
+        {
+            texelWeights[i] = kernel == FILTER_BOX ? 1.0f : exp(-0.5f * i * i / (sigma * sigma));
+            sum += i == 0 ? texelWeights[i] : 2.0f * texelWeights[i];
+        }
+
+        FilterTaps taps;
+        taps.offsets[0] = 0.0f;
+        taps.weights[0] = texelWeights[0] / sum;
+        taps.count = 1;
+        for(unsigned int i = 1; i <= radius; i += 2)
+        {
+            const float a = texelWeights[i] / sum;
+            const float b = i + 1 <= radius ? texelWeights[i + 1] / sum : 0.0f;
+            taps.weights[taps.count] = a + b;
+            taps.offsets[taps.count] = i + b / (a + b);
+            taps.count++;
+        }
+        return taps;
+    }
+};
+
+// blurs a texture with a separable kernel in two passes, horizontal into an intermediate target and vertical
+// into the result, so a radius r costs O(r) fetches per pixel instead of O(r^2), halved again by the bilinear
+// taps. offsets are in texels of the source, so the blur looks the same at any resolution.
+class SeparableFilter
+{
+public:
+    // shader is bloom.vs with separable_filter.fs; both targets are added to targets, at the output size
+    // scaled by the render scale. needs a current context
+    SeparableFilter(RenderTargets &targets, Shader &filterShader, GLenum format = GL_RGBA16F)
+        : shader(&filterShader)
+    {
+        intermediate = &targets.Add({ format }, false);
+        result = &targets.Add({ format }, false);
+        emptyVao = VertexArrayHandle::Create();
+
+        uvScaleUniform = shader->Uniform("sourceUvScale");
+        directionUniform = shader->Uniform("direction");
+        countUniform = shader->Uniform("tapCount");
+        offsetsUniform = shader->Uniform("offsets");
+        weightsUniform = shader->Uniform("weights");
+        shader->use();
+        shader->setInt("source", 0);
+    }
+
+    SeparableFilter(const SeparableFilter&) = delete;
+    SeparableFilter& operator=(const SeparableFilter&) = delete;
+
+    // the taps are only rebuilt when the kernel or the radius change
+    void SetKernel(FilterKernel filterKernel, unsigned int filterRadius)
+    {
+        filterRadius = min(filterRadius, FILTER_MAX_RADIUS);
+        if(filterKernel == kernel && filterRadius == radius)
+            return;
+        kernel = filterKernel;
+        radius = filterRadius;
+        taps = FilterTaps::Build(kernel, radius);
+        uploaded = false;
+    }
+
+    // filters source, a texture whose lower left sourceUvScale part holds the image, which has to match the
+    // targets' active size for the taps to land between texels. leaves the result's framebuffer bound and
+    // texture unit 0 active.
+    void Apply(GLuint source, const glm::vec2 &sourceUvScale)
+    {
+        shader->use();
+        if(!uploaded)
+        {
+            shader->setInt(countUniform, (int)taps.count);
+            shader->setFloatArray(offsetsUniform, taps.offsets, FILTER_MAX_TAPS);
+            shader->setFloatArray(weightsUniform, taps.weights, FILTER_MAX_TAPS);
+            uploaded = true;
+        }
+        glBindVertexArray(emptyVao.Get());
+        glActiveTexture(GL_TEXTURE0);
+
+        intermediate->Bind();
+        shader->setVec2(uvScaleUniform, sourceUvScale);
+        shader->setVec2(directionUniform, glm::vec2(1.0f, 0.0f));
+        glBindTexture(GL_TEXTURE_2D, source);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        result->Bind();
+        shader->setVec2(uvScaleUniform, intermediate->UvScale());
+        shader->setVec2(directionUniform, glm::vec2(0.0f, 1.0f));
+        glBindTexture(GL_TEXTURE_2D, intermediate->Color(0));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glBindVertexArray(0);
+    }
+
+    GLuint Result() const { return result->Color(0); }
+    glm::vec2 UvScale() const { return result->UvScale(); }
+    // texture fetches per pixel and pass
+    unsigned int TapCount() const { return taps.count * 2 - 1; }
+
+private:
+    Shader *shader;
+    UniformHandle uvScaleUniform, directionUniform, countUniform, offsetsUniform, weightsUniform;
+    RenderTarget *intermediate, *result;
+    VertexArrayHandle emptyVao;
+    FilterKernel kernel = FILTER_KERNEL_COUNT;  // nothing built yet
+    unsigned int radius = 0;
+    FilterTaps taps;
+    bool uploaded = false;
+};
+#endif
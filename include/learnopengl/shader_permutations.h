@@ -0,0 +1,53 @@
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+using namespace std;
+
+// the variants of one shader source specialized by preprocessor defines: a feature switched per frame becomes
+// an #if in the shader instead of a uniform branch every pixel evaluates. each variant is compiled the first
+// time it is asked for and kept, keyed by its defines regardless of their order.
+class ShaderPermutations
+{
+public:
+    ShaderPermutations(const char *vertexPath, const char *fragmentPath, const char *geometryPath = nullptr)
+        : vertex(vertexPath), fragment(fragmentPath), geometry(geometryPath ? geometryPath : "")
+    {
+    }
+
+    ShaderPermutations(const ShaderPermutations&) = delete;
+    ShaderPermutations& operator=(const ShaderPermutations&) = delete;
+
+    // the variant with exactly these defines, compiled (needs a current context) if it wasn't yet.
+    // the reference stays valid as long as the permutations do
+    Shader &Get(const ShaderDefines &defines)
+    {
+        ShaderDefines sorted(defines);
+        sort(sorted.begin(), sorted.end());
+        string key;
+        for(const string &define : sorted)
+            key += define + ";";
+
+        unordered_map<string, unique_ptr<Shader>>::iterator found = variants.find(key);
+        if(found == variants.end())
+        {
+            unique_ptr<Shader> shader(new Shader(vertex.c_str(), fragment.c_str(),
+                                                 geometry.empty() ? nullptr : geometry.c_str(), sorted));
+            found = variants.emplace(key, move(shader)).first;
+        }
+        return *found->second;
+    }
+
+    // variants compiled so far
+    size_t Size() const { return variants.size(); }
+
+private:
+    string vertex, fragment, geometry;
+    unordered_map<string, unique_ptr<Shader>> variants;
+};
+#endif
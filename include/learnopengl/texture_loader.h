@@ -0,0 +1,404 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/dds.h>
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/thread_pool.h>
+
+#include <sys/stat.h>
+
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// asynchronous texture loading. Load2D/LoadCubemap return a texture name right away that shows a 1x1
+// placeholder; the image files are decoded on worker threads and Update (called once per frame on the
+// context thread) streams the finished ones into their textures through a small ring of pixel buffers.
+// if tools/texture_baker left an up to date .dds next to an image, its prebuilt block compressed mip chain
+// is uploaded as is instead of decoding the image and generating mipmaps.
+class TextureLoader
+{
+public:
+    // number of pixel buffers in the ring; a buffer is only refilled once the GPU is done reading from it
+    static const unsigned int PBO_COUNT = 3;
+    // frames a request may fail to map a pixel buffer before it gives up and keeps its placeholder
+    static const unsigned int MAX_MAP_ATTEMPTS = 8;
+
+    // process-wide loader, shared by the model loader and the loose textures in main
+    static TextureLoader &Instance()
+    {
+        static TextureLoader loader;
+        return loader;
+    }
+
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    // 2D texture with mipmaps; transparent images can be clamped so that their edges don't bleed when tiled
+    unsigned int Load2D(const string &path, bool clampTransparent = false)
+    {
+        shared_ptr<Request> request(new Request);
+        request->target = GL_TEXTURE_2D;
+        request->clampTransparent = clampTransparent;
+        request->paths.push_back(path);
+        return enqueue(request);
+    }
+
+    // cubemap, faces in the +X, -X, +Y, -Y, +Z, -Z order
+    unsigned int LoadCubemap(const vector<string> &faces)
+    {
+        shared_ptr<Request> request(new Request);
+        request->target = GL_TEXTURE_CUBE_MAP;
+        request->paths = faces;
+        return enqueue(request);
+    }
+
+    // uploads decoded images until roughly byteBudget bytes went through the pixel buffers this frame.
+    // at least one image is uploaded per call (if one is ready) so that large images can't starve.
+    void Update(size_t byteBudget = 16 * 1024 * 1024)
+    {
+        vector<shared_ptr<Request>> ready;
+        {
+            lock_guard<mutex> lock(queueMutex);
+            ready.swap(decoded);
+        }
+        size_t uploaded = 0;
+        unsigned int i = 0;
+        for(; i < ready.size(); i++)
+        {
+            if(ready[i]->cancelled)
+            {
+                // the texture was deleted while decoding (its name may belong to a new texture by now),
+                // just drop the pixels
+                discard(*ready[i]);
+                continue;
+            }
+            if(i > 0 && uploaded >= byteBudget)
+                break;
+            size_t bytes = ready[i]->ByteSize();
+            if(!upload(*ready[i]))
+                break; // every pixel buffer is still in flight, try again next frame
+            uploaded += bytes;
+            pending.erase(ready[i]->textureID);
+        }
+        if(i < ready.size())
+        {
+            // put the rest back at the front, keeping the original order
+            lock_guard<mutex> lock(queueMutex);
+            decoded.insert(decoded.begin(), ready.begin() + i, ready.end());
+        }
+    }
+
+    // uploads everything that is still outstanding, blocking until all decodes are done
+    void Finish()
+    {
+        while(Pending() > 0)
+        {
+            Update((size_t)-1);
+            this_thread::yield();
+        }
+    }
+
+    // forgets a texture that is about to be deleted, so its pending upload doesn't target a dead name
+    // (or, once glGenTextures hands the name out again, a texture loaded after it)
+    void Cancel(unsigned int textureID)
+    {
+        unordered_map<unsigned int, shared_ptr<Request>>::iterator found = pending.find(textureID);
+        if(found == pending.end())
+            return;
+        found->second->cancelled = true;
+        pending.erase(found);
+    }
+
+    // number of textures that still show their placeholder
+    unsigned int Pending() const { return (unsigned int)pending.size(); }
+
+    // releases the pixel buffers; must run while the context is still alive
+    void Shutdown()
+    {
+        for(Slot &slot : slots)
+        {
+            if(slot.fence)
+                glDeleteSync(slot.fence);
+            if(slot.pbo)
+                glDeleteBuffers(1, &slot.pbo);
+            slot = Slot();
+        }
+    }
+
+private:
+    struct Image {
+        unsigned char *data = nullptr;
+        int width = 0;
+        int height = 0;
+        int nrComponents = 0;
+        DDSImage compressed;    // used instead of data when its format is set
+
+        bool Compressed() const { return compressed.format != 0; }
+        bool Valid() const { return data || Compressed(); }
+        size_t ByteSize() const { return Compressed() ? compressed.data.size() : (size_t)width * height * nrComponents; }
+    };
+
+    struct Request {
+        unsigned int textureID = 0;
+        GLenum target = GL_TEXTURE_2D;
+        bool clampTransparent = false;
+        bool cancelled = false;  // set by Cancel on the context thread, the decoded pixels are dropped
+        unsigned int mapFailures = 0;
+        vector<string> paths;
+        vector<Image> images;    // one per path once decoded
+
+        size_t ByteSize() const
+        {
+            size_t size = 0;
+            for(const Image &image : images)
+                size += image.ByteSize();
+            return size;
+        }
+    };
+
+    struct Slot {
+        unsigned int pbo = 0;
+        GLsync fence = nullptr;
+    };
+
+    Slot slots[PBO_COUNT];
+    unsigned int nextSlot = 0;
+    // textures whose data hasn't been uploaded yet, with the request that will fill them
+    unordered_map<unsigned int, shared_ptr<Request>> pending;
+
+    mutex queueMutex;
+    vector<shared_ptr<Request>> decoded;
+
+    // declared last so it is destroyed (and its workers joined) before the queue they push into
+    ThreadPool pool;
+
+    TextureLoader() {}
+
+    unsigned int enqueue(shared_ptr<Request> request)
+    {
+        glGenTextures(1, &request->textureID);
+        setPlaceholder(*request);
+        pending[request->textureID] = request;
+
+        // the extension check needs the context, so it happens here and not on the worker
+        const bool allowCompressed = GLExtensions::S3TC();
+        pool.Submit([this, request, allowCompressed] {
+            try
+            {
+                decode(*request, allowCompressed);
+            }
+            catch(const exception &e)
+            {
+                // the request has to come back either way, or it would stay pending and Finish wait on it forever;
+                // without images it just keeps its placeholder
+                cout << "ERROR::TEXTURE_LOADER::DECODE_FAILED " << request->paths[0] << " " << e.what() << endl;
+                discard(*request);
+            }
+            lock_guard<mutex> lock(queueMutex);
+            decoded.push_back(request);
+        });
+        return request->textureID;
+    }
+
+    // fills request.images on a worker thread
+    static void decode(Request &request, bool allowCompressed)
+    {
+        // all cubemap faces have to agree on the format, so only go compressed if every face was baked,
+        // reads and came out in the same block format (the baker picks BC3 or BC1 per image)
+        bool compressed = allowCompressed;
+        for(const string &path : request.paths)
+            compressed = compressed && bakedIsFresh(path);
+
+        for(unsigned int i = 0; compressed && i < request.paths.size(); i++)
+        {
+            Image image;
+            compressed = ReadDDS(bakedPath(request.paths[i]), image.compressed)
+                      && (i == 0 || image.compressed.format == request.images[0].compressed.format);
+            if(compressed)
+            {
+                image.width = image.compressed.levels[0].width;
+                image.height = image.compressed.levels[0].height;
+                image.nrComponents = image.compressed.format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? 4 : 3;
+                request.images.push_back(std::move(image));
+            }
+        }
+        if(!compressed)
+        {
+            request.images.clear();
+            for(const string &path : request.paths)
+            {
+                Image image;
+                image.data = stbi_load(path.c_str(), &image.width, &image.height, &image.nrComponents, 0);
+                if(!image.data)
+                    std::cout << "Texture failed to load at path: " << path << std::endl;
+                request.images.push_back(std::move(image));
+            }
+        }
+    }
+
+    // the baked counterpart of an image, e.g. wood_texture.png -> wood_texture.dds
+    static string bakedPath(const string &path)
+    {
+        return path.substr(0, path.find_last_of('.')) + ".dds";
+    }
+
+    // a baked file older than its source is ignored, so editing an image never shows stale pixels
+    static bool bakedIsFresh(const string &path)
+    {
+        struct stat source, baked;
+        if(stat(bakedPath(path).c_str(), &baked) != 0)
+            return false;
+        return stat(path.c_str(), &source) != 0 || baked.st_mtime >= source.st_mtime;
+    }
+
+    // mid-grey 1x1 texture, so that anything sampling the texture before its data arrives still renders sensibly
+    static void setPlaceholder(const Request &request)
+    {
+        static const unsigned char grey[4] = {128, 128, 128, 255};
+        glBindTexture(request.target, request.textureID);
+        if(request.target == GL_TEXTURE_CUBE_MAP)
+        {
+            for(unsigned int face = 0; face < 6; face++)
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        }
+        glTexParameteri(request.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(request.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    static GLenum formatOf(int nrComponents)
+    {
+        if(nrComponents == 1)
+            return GL_RED;
+        if(nrComponents == 2)
+            return GL_RG;
+        if(nrComponents == 4)
+            return GL_RGBA;
+        return GL_RGB;
+    }
+
+    // copies the decoded pixels into the next free pixel buffer and sources the texture from it,
+    // so the driver can do the actual transfer asynchronously. returns false if no buffer is free or it
+    // couldn't be mapped, the request is kept for a retry then (up to MAX_MAP_ATTEMPTS times for the latter).
+    bool upload(Request &request)
+    {
+        Slot &slot = slots[nextSlot];
+        if(slot.fence)
+        {
+            if(glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                return false;
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+        }
+        if(!slot.pbo)
+            glGenBuffers(1, &slot.pbo);
+        nextSlot = (nextSlot + 1) % PBO_COUNT;
+
+        const size_t size = request.ByteSize();
+        bool complete = size > 0;
+        for(const Image &image : request.images)
+            complete = complete && image.Valid();
+
+        if(complete)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+            unsigned char *mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            if(!mapped)
+            {
+                cout << "ERROR::TEXTURE_LOADER::MAP_FAILED " << request.paths[0] << endl;
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                // leave the pixels with the request, Update puts it back and it is retried next frame; a buffer
+                // that never maps would keep it pending forever though, so at some point keep the placeholder
+                if(++request.mapFailures < MAX_MAP_ATTEMPTS)
+                    return false;
+                discard(request);
+                return true;
+            }
+            size_t offset = 0;
+            for(const Image &image : request.images)
+            {
+                memcpy(mapped + offset, image.Compressed() ? image.compressed.data.data() : image.data, image.ByteSize());
+                offset += image.ByteSize();
+            }
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+            glBindTexture(request.target, request.textureID);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // stb_image rows are tightly packed
+            offset = 0;
+            for(unsigned int i = 0; i < request.images.size(); i++)
+            {
+                const Image &image = request.images[i];
+                if(image.Compressed())
+                {
+                    // the whole prebuilt mip chain, no glGenerateMipmap needed afterwards
+                    GLenum target = request.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + i : GL_TEXTURE_2D;
+                    for(unsigned int level = 0; level < image.compressed.levels.size(); level++)
+                    {
+                        const DDSLevel &mip = image.compressed.levels[level];
+                        glCompressedTexImage2D(target, level, image.compressed.format, mip.width, mip.height, 0, mip.size, (void*)(offset + mip.offset));
+                    }
+                    glTexParameteri(request.target, GL_TEXTURE_MAX_LEVEL, image.compressed.levels.size() - 1);
+                }
+                else if(request.target == GL_TEXTURE_CUBE_MAP)
+                {
+                    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, image.width, image.height, 0, formatOf(image.nrComponents), GL_UNSIGNED_BYTE, (void*)offset);
+                }
+                else
+                {
+                    GLenum format = formatOf(image.nrComponents);
+                    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, (void*)offset);
+                }
+                offset += image.ByteSize();
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            setParameters(request);
+            slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        discard(request);
+        return true;
+    }
+
+    static void discard(Request &request)
+    {
+        for(Image &image : request.images)
+            stbi_image_free(image.data);
+        request.images.clear();
+    }
+
+    static void setParameters(const Request &request)
+    {
+        if(request.target == GL_TEXTURE_CUBE_MAP)
+        {
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            return;
+        }
+        const bool clamp = request.clampTransparent && request.images[0].nrComponents == 4;
+        if(!request.images[0].Compressed())
+            glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, clamp ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, clamp ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+};
+#endif
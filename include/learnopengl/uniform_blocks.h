@@ -0,0 +1,201 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_handle.h>
+
+#include <cstring>
+
+// binding points of the std140 uniform blocks shared by all shaders. GLSL 3.30 has no layout(binding),
+// so every program gets its blocks pointed here by name right after linking (see BindUniformBlocks).
+enum UniformBlockBinding {
+    UNIFORM_BLOCK_CAMERA = 0,
+    UNIFORM_BLOCK_LIGHTS,
+    UNIFORM_BLOCK_FRAME,
+    UNIFORM_BLOCK_COUNT
+};
+
+const char *const UNIFORM_BLOCK_NAMES[UNIFORM_BLOCK_COUNT] = { "Camera", "Lights", "Frame" };
+
+// number of point lights in the Lights block, BROJ_POZICIONIH_SVETALA in the shaders
+const unsigned int UNIFORM_POINT_LIGHTS = 1;
+
+// CPU mirrors of the blocks, laid out by the std140 rules: vec3 takes 16 bytes unless a float follows it,
+// structs and arrays round up to 16 bytes. the padding members are never read.
+//   layout (std140) uniform Camera { mat4 projection; mat4 view; vec3 viewPosition; };
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPosition;
+    float padding;
+};
+
+struct DirLightStd140 {
+    glm::vec3 direction;
+    float padding0;
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float padding3;
+};
+
+// same member order as PointLight in 2.model_lighting.fs
+struct PointLightStd140 {
+    glm::vec3 position;
+    float padding0;
+    glm::vec3 specular;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 ambient;
+    float constant;
+    float linear;
+    float quadratic;
+    float padding3[2];
+};
+
+//   layout (std140) uniform Lights { DirLight dirLight; PointLight pointLight[BROJ_POZICIONIH_SVETALA]; };
+struct LightsBlock {
+    DirLightStd140 dirLight;
+    PointLightStd140 pointLight[UNIFORM_POINT_LIGHTS];
+};
+
+//   layout (std140) uniform Frame { float time; float deltaTime; float bloomThreshold; };
+struct FrameBlock {
+    float time;
+    float deltaTime;
+    float bloomThreshold;   // brightness above which the lit color goes into the bloom attachment
+    float padding;
+};
+
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock does not match the std140 Camera block");
+static_assert(sizeof(DirLightStd140) == 64 && sizeof(PointLightStd140) == 80, "light structs do not match std140");
+static_assert(sizeof(FrameBlock) == 16, "FrameBlock does not match the std140 Frame block");
+
+// points the shared blocks a program declares at their binding points; blocks it doesn't use are skipped
+inline void BindUniformBlocks(GLuint program)
+{
+    for(unsigned int binding = 0; binding < UNIFORM_BLOCK_COUNT; binding++)
+    {
+        const GLuint index = glGetUniformBlockIndex(program, UNIFORM_BLOCK_NAMES[binding]);
+        if(index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, binding);
+    }
+}
+
+// frames the CPU may run ahead of the GPU before Upload waits
+const unsigned int UNIFORM_FRAMES_IN_FLIGHT = 3;
+
+// per-frame uniform data of all shaders in one buffer, written once per frame instead of per program.
+// the buffer holds UNIFORM_FRAMES_IN_FLIGHT copies (slots) used round robin, each guarded by a fence, so a
+// slot is only overwritten once the GPU finished the frame that read it and writing never stalls on a draw.
+// usage per frame: fill camera/lights/frame, Upload() before drawing, EndFrame() after the last draw.
+class FrameUniforms
+{
+public:
+    CameraBlock camera;
+    LightsBlock lights;
+    FrameBlock frame;
+
+    // creates the buffer, needs a current context
+    FrameUniforms() : camera(), lights(), frame()
+    {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        const GLsizeiptr sizes[UNIFORM_BLOCK_COUNT] = { sizeof(CameraBlock), sizeof(LightsBlock), sizeof(FrameBlock) };
+        slotSize = 0;
+        for(unsigned int block = 0; block < UNIFORM_BLOCK_COUNT; block++)
+        {
+            offsets[block] = slotSize;
+            slotSize += alignUp(sizes[block], alignment);
+        }
+
+        buffer = BufferHandle::Create();
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer.Get());
+        glBufferData(GL_UNIFORM_BUFFER, slotSize * UNIFORM_FRAMES_IN_FLIGHT, nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        for(unsigned int i = 0; i < UNIFORM_FRAMES_IN_FLIGHT; i++)
+            fences[i] = nullptr;
+    }
+
+    ~FrameUniforms()
+    {
+        if(!GLContextLifetime::Alive())
+            return;
+        for(unsigned int i = 0; i < UNIFORM_FRAMES_IN_FLIGHT; i++)
+        {
+            if(fences[i])
+                glDeleteSync(fences[i]);
+        }
+    }
+
+    FrameUniforms(const FrameUniforms&) = delete;
+    FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+    // copies the blocks into the next slot and binds it to the block binding points
+    void Upload()
+    {
+        slot = (slot + 1) % UNIFORM_FRAMES_IN_FLIGHT;
+        waitForSlot();
+
+        const GLintptr base = slot * slotSize;
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer.Get());
+        // unsynchronized: the fence already guarantees the GPU is done with this slot
+        void *mapped = glMapBufferRange(GL_UNIFORM_BUFFER, base, slotSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if(mapped)
+        {
+            unsigned char *bytes = (unsigned char*)mapped;
+            memcpy(bytes + offsets[UNIFORM_BLOCK_CAMERA], &camera, sizeof(camera));
+            memcpy(bytes + offsets[UNIFORM_BLOCK_LIGHTS], &lights, sizeof(lights));
+            memcpy(bytes + offsets[UNIFORM_BLOCK_FRAME], &frame, sizeof(frame));
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_CAMERA, buffer.Get(), base + offsets[UNIFORM_BLOCK_CAMERA], sizeof(CameraBlock));
+        glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_LIGHTS, buffer.Get(), base + offsets[UNIFORM_BLOCK_LIGHTS], sizeof(LightsBlock));
+        glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_FRAME, buffer.Get(), base + offsets[UNIFORM_BLOCK_FRAME], sizeof(FrameBlock));
+    }
+
+    // marks the current slot as in use by everything submitted so far
+    void EndFrame()
+    {
+        if(fences[slot])
+            glDeleteSync(fences[slot]);
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+private:
+    BufferHandle buffer;
+    GLsync fences[UNIFORM_FRAMES_IN_FLIGHT];
+    GLintptr offsets[UNIFORM_BLOCK_COUNT];
+    GLsizeiptr slotSize;
+    unsigned int slot = UNIFORM_FRAMES_IN_FLIGHT - 1;
+
+    static GLsizeiptr alignUp(GLsizeiptr size, GLint alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    void waitForSlot()
+    {
+        if(!fences[slot])
+            return;
+        // the first wait flushes, so the fence is guaranteed to signal eventually
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        for(;;)
+        {
+            const GLenum result = glClientWaitSync(fences[slot], flags, 1000000);    // 1 ms
+            if(result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED)
+                break;
+            flags = 0;
+        }
+        glDeleteSync(fences[slot]);
+        fences[slot] = nullptr;
+    }
+};
+#endif
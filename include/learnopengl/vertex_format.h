@@ -0,0 +1,286 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// attribute locations every mesh shader agrees on, in the order of the fields of Vertex
+enum VertexAttribute {
+    ATTRIB_POSITION = 0,
+    ATTRIB_NORMAL,
+    ATTRIB_TEXCOORDS,
+    ATTRIB_TANGENT,
+    ATTRIB_BITANGENT,
+    ATTRIB_COUNT
+};
+
+// first of the four vec4 locations (5 to 8) an instanced shader reads its per-instance model matrix from
+const unsigned int ATTRIB_INSTANCE_MODEL = ATTRIB_COUNT;
+
+// which attributes a mesh stores and how compactly. packed attributes need a matching shader:
+//   quantizedPositions: 3x 16-bit unorm relative to the mesh bounds, the shader computes
+//                       aPos * positionScale + positionOffset (both uniforms are set by Mesh::Draw)
+//   octahedralNormals:  normal as vec2 (2x 16-bit snorm, octahedral), tangent as vec3 with the octahedral
+//                       tangent in xy and the bitangent sign in z; the bitangent itself is not stored
+//   halfTexCoords:      2x half float, transparent to the shader. meshes whose uvs wrap far outside
+//                       [-2, 2] keep full floats since half precision would smear texels there.
+struct VertexFormat {
+    unsigned int attributes = (1u << ATTRIB_COUNT) - 1;
+    bool quantizedPositions = false;
+    bool octahedralNormals = false;
+    bool halfTexCoords = false;
+
+    bool Has(VertexAttribute attribute) const { return (attributes & (1u << attribute)) != 0; }
+
+    // the plain 56 byte Vertex, as the meshes always used to be uploaded
+    bool IsFull() const
+    {
+        return attributes == (1u << ATTRIB_COUNT) - 1 && !quantizedPositions && !octahedralNormals && !halfTexCoords;
+    }
+
+    // the most compact format a linked program can consume: only the attributes it actually reads,
+    // octahedral normals if it declares aNormal as a vec2 and quantized positions if it has the
+    // dequantization uniforms. has to run on the context thread.
+    static VertexFormat FromProgram(GLuint program)
+    {
+        VertexFormat format;
+        format.attributes = 0;
+        format.halfTexCoords = true;
+
+        GLint count = 0;
+        glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+        for(GLint i = 0; i < count; i++)
+        {
+            char name[256];
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveAttrib(program, i, sizeof(name), nullptr, &size, &type, name);
+            GLint location = glGetAttribLocation(program, name);
+            if(location < 0 || location >= ATTRIB_COUNT)
+                continue;
+            format.attributes |= 1u << location;
+            if(location == ATTRIB_NORMAL && type == GL_FLOAT_VEC2)
+                format.octahedralNormals = true;
+        }
+        // the bitangent is rebuilt from normal, tangent and sign
+        if(format.octahedralNormals)
+            format.attributes &= ~(1u << ATTRIB_BITANGENT);
+        format.quantizedPositions = format.Has(ATTRIB_POSITION) && glGetUniformLocation(program, "positionScale") != -1;
+        return format;
+    }
+};
+
+// a VertexFormat resolved for one mesh: the byte layout of a vertex and the dequantization constants
+struct VertexLayout {
+    VertexFormat format;
+    unsigned int stride = 0;
+    unsigned int offsets[ATTRIB_COUNT] = {0, 0, 0, 0, 0};
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+
+    // sizes of the attributes in this layout, everything is kept 4-byte aligned
+    static unsigned int AttributeSize(const VertexFormat &format, VertexAttribute attribute)
+    {
+        switch(attribute)
+        {
+            case ATTRIB_POSITION:  return format.quantizedPositions ? 8 : 12;
+            case ATTRIB_NORMAL:    return format.octahedralNormals ? 4 : 12;
+            case ATTRIB_TEXCOORDS: return format.halfTexCoords ? 4 : 8;
+            case ATTRIB_TANGENT:   return format.octahedralNormals ? 8 : 12;
+            default:               return 12;
+        }
+    }
+
+    explicit VertexLayout(const VertexFormat &vertexFormat = VertexFormat()) : format(vertexFormat)
+    {
+        for(unsigned int attribute = 0; attribute < ATTRIB_COUNT; attribute++)
+        {
+            if(!format.Has((VertexAttribute)attribute))
+                continue;
+            offsets[attribute] = stride;
+            stride += AttributeSize(format, (VertexAttribute)attribute);
+        }
+    }
+
+    // points the attributes of the bound VAO at the bound GL_ARRAY_BUFFER
+    void SetupAttributes() const
+    {
+        for(unsigned int attribute = 0; attribute < ATTRIB_COUNT; attribute++)
+        {
+            if(!format.Has((VertexAttribute)attribute))
+                continue;
+            const void *offset = (void*)(size_t)offsets[attribute];
+            glEnableVertexAttribArray(attribute);
+            if(attribute == ATTRIB_POSITION && format.quantizedPositions)
+                glVertexAttribPointer(attribute, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, offset);
+            else if(attribute == ATTRIB_NORMAL && format.octahedralNormals)
+                glVertexAttribPointer(attribute, 2, GL_SHORT, GL_TRUE, stride, offset);
+            else if(attribute == ATTRIB_TANGENT && format.octahedralNormals)
+                glVertexAttribPointer(attribute, 3, GL_SHORT, GL_TRUE, stride, offset);
+            else if(attribute == ATTRIB_TEXCOORDS)
+                glVertexAttribPointer(attribute, 2, format.halfTexCoords ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, stride, offset);
+            else
+                glVertexAttribPointer(attribute, 3, GL_FLOAT, GL_FALSE, stride, offset);
+        }
+    }
+};
+
+// IEEE half with round to nearest; uvs never come close to the overflow or NaN cases
+inline uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if(exponent <= 0)
+    {
+        if(exponent < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000;
+        const int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        if((mantissa >> (shift - 1)) & 1)
+            half++;
+        return (uint16_t)(sign | half);
+    }
+    if(exponent >= 31)
+        return (uint16_t)(sign | 0x7C00);
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    if(mantissa & 0x1000)
+        half++;    // a carry into the exponent is still the correctly rounded value
+    return (uint16_t)half;
+}
+
+inline int16_t ToSnorm16(float value)
+{
+    return (int16_t)lround(min(max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+// octahedral encoding of a unit vector into [-1, 1]^2. decoded in GLSL by
+//   vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y)); float t = max(-n.z, 0.0);
+//   n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t); n = normalize(n);
+inline void OctahedralEncode(const glm::vec3 &n, int16_t out[2])
+{
+    const float length = fabs(n.x) + fabs(n.y) + fabs(n.z);
+    float x = length > 0.0f ? n.x / length : 0.0f;
+    float y = length > 0.0f ? n.y / length : 0.0f;
+    if(n.z < 0.0f)
+    {
+        const float foldedX = (1.0f - fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const float foldedY = (1.0f - fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    out[0] = ToSnorm16(x);
+    out[1] = ToSnorm16(y);
+}
+
+// converts full vertices into the given format. the layout that comes back holds the resolved format
+// (half uvs may be refused for this mesh) and the position dequantization for the shader. positions are
+// quantized to the given box (low, high) if there is one, e.g. the bounds of a whole model so that all of
+// its meshes share the dequantization, otherwise to the bounds of these vertices.
+template<typename FullVertex>
+VertexLayout PackVertices(const FullVertex *vertices, size_t count, VertexFormat format, vector<unsigned char> &out,
+                          const glm::vec3 *quantizationBox = nullptr)
+{
+    glm::vec3 low(0.0f), high(0.0f);
+    float maxTexCoord = 0.0f;
+    for(size_t i = 0; i < count; i++)
+    {
+        const glm::vec3 &p = vertices[i].Position;
+        low = i == 0 ? p : glm::vec3(min(low.x, p.x), min(low.y, p.y), min(low.z, p.z));
+        high = i == 0 ? p : glm::vec3(max(high.x, p.x), max(high.y, p.y), max(high.z, p.z));
+        maxTexCoord = max(maxTexCoord, max(fabs(vertices[i].TexCoords.x), fabs(vertices[i].TexCoords.y)));
+    }
+    if(maxTexCoord > 2.0f)
+        format.halfTexCoords = false;
+    if(quantizationBox)
+    {
+        low = quantizationBox[0];
+        high = quantizationBox[1];
+    }
+
+    VertexLayout layout(format);
+    if(format.quantizedPositions)
+    {
+        const glm::vec3 extent = high - low;
+        layout.positionOffset = low;
+        layout.positionScale = glm::vec3(extent.x > 0.0f ? extent.x : 1.0f, extent.y > 0.0f ? extent.y : 1.0f, extent.z > 0.0f ? extent.z : 1.0f);
+    }
+
+    out.assign(count * layout.stride, 0);
+    for(size_t i = 0; i < count; i++)
+    {
+        const FullVertex &vertex = vertices[i];
+        unsigned char *base = out.data() + i * layout.stride;
+
+        if(format.Has(ATTRIB_POSITION))
+        {
+            unsigned char *dst = base + layout.offsets[ATTRIB_POSITION];
+            if(format.quantizedPositions)
+            {
+                const glm::vec3 &p = vertex.Position;
+                uint16_t q[3] = {
+                    (uint16_t)lround((p.x - layout.positionOffset.x) / layout.positionScale.x * 65535.0f),
+                    (uint16_t)lround((p.y - layout.positionOffset.y) / layout.positionScale.y * 65535.0f),
+                    (uint16_t)lround((p.z - layout.positionOffset.z) / layout.positionScale.z * 65535.0f)
+                };
+                memcpy(dst, q, sizeof(q));
+            }
+            else
+                memcpy(dst, &vertex.Position, 12);
+        }
+        if(format.Has(ATTRIB_NORMAL))
+        {
+            unsigned char *dst = base + layout.offsets[ATTRIB_NORMAL];
+            if(format.octahedralNormals)
+            {
+                int16_t e[2];
+                OctahedralEncode(vertex.Normal, e);
+                memcpy(dst, e, sizeof(e));
+            }
+            else
+                memcpy(dst, &vertex.Normal, 12);
+        }
+        if(format.Has(ATTRIB_TEXCOORDS))
+        {
+            unsigned char *dst = base + layout.offsets[ATTRIB_TEXCOORDS];
+            if(format.halfTexCoords)
+            {
+                uint16_t h[2] = { FloatToHalf(vertex.TexCoords.x), FloatToHalf(vertex.TexCoords.y) };
+                memcpy(dst, h, sizeof(h));
+            }
+            else
+                memcpy(dst, &vertex.TexCoords, 8);
+        }
+        if(format.Has(ATTRIB_TANGENT))
+        {
+            unsigned char *dst = base + layout.offsets[ATTRIB_TANGENT];
+            if(format.octahedralNormals)
+            {
+                // handedness of the tangent frame, so the shader can rebuild B = cross(N, T) * sign
+                const glm::vec3 &n = vertex.Normal, &t = vertex.Tangent, &b = vertex.Bitangent;
+                const glm::vec3 nxt(n.y * t.z - n.z * t.y, n.z * t.x - n.x * t.z, n.x * t.y - n.y * t.x);
+                const float handedness = nxt.x * b.x + nxt.y * b.y + nxt.z * b.z;
+                int16_t e[4] = { 0, 0, (int16_t)(handedness < 0.0f ? -32767 : 32767), 0 };
+                OctahedralEncode(vertex.Tangent, e);
+                memcpy(dst, e, sizeof(e));
+            }
+            else
+                memcpy(dst, &vertex.Tangent, 12);
+        }
+        if(format.Has(ATTRIB_BITANGENT))
+            memcpy(base + layout.offsets[ATTRIB_BITANGENT], &vertex.Bitangent, 12);
+    }
+    return layout;
+}
+#endif
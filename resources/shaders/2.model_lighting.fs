@@ -33,13 +33,29 @@ in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
 
+// UNIFORM_POINT_LIGHTS, defined by the application so the Lights block matches its buffer
+#ifndef BROJ_POZICIONIH_SVETALA
 #define BROJ_POZICIONIH_SVETALA 1
+#endif
 
-uniform DirLight dirLight;
-uniform PointLight pointLight[BROJ_POZICIONIH_SVETALA];
-uniform Material material;
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLight[BROJ_POZICIONIH_SVETALA];
+};
 
-uniform vec3 viewPosition;
+layout (std140) uniform Frame {
+    float time;
+    float deltaTime;
+    float bloomThreshold;
+};
+
+uniform Material material;
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
@@ -84,10 +100,11 @@ void main()
     vec3 result = CalcDirLight(dirLight, normal, viewDir);
    for(int i = 0; i < BROJ_POZICIONIH_SVETALA; i++)
            result += CalcPointLight(pointLight[i], normal, FragPos, viewDir);
+    // what exceeds the threshold goes to bloom, with a soft knee instead of a hard cut so it doesn't flicker
     float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
-    if(brightness > 1.0)
-            BrightColor = vec4(result, 1.0);
-        else
-            BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+    float knee = bloomThreshold * 0.5;
+    float soft = clamp(brightness - bloomThreshold + knee, 0.0, 2.0 * knee);
+    soft = soft * soft / (4.0 * knee + 0.0001);
+    BrightColor = vec4(result * max(soft, brightness - bloomThreshold) / max(brightness, 0.0001), 1.0);
     FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
@@ -1,20 +1,36 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec3 aPos;         // quantized to the mesh bounds, see positionScale/positionOffset
+layout (location = 1) in vec2 aNormal;      // octahedral encoded
 layout (location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+// the depth pre-pass runs this same shader, both have to produce bit identical depth
+invariant gl_Position;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+    FragPos = vec3(model * vec4(aPos * positionScale + positionOffset, 1.0));
+    Normal = octahedralDecode(aNormal);
     TexCoords = aTexCoords;    
     gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+}
@@ -1,5 +1,6 @@
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
 
 in VS_OUT {
     vec3 FragPos;
@@ -7,10 +8,48 @@ in VS_OUT {
     vec2 TexCoords;
 } fs_in;
 
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+#ifndef BROJ_POZICIONIH_SVETALA
+#define BROJ_POZICIONIH_SVETALA 1
+#endif
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLight[BROJ_POZICIONIH_SVETALA];
+};
+
+layout (std140) uniform Frame {
+    float time;
+    float deltaTime;
+    float bloomThreshold;
+};
+
 uniform sampler2D floorTexture;
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform bool blinn;
 
 void main()
 {
@@ -20,23 +59,23 @@ void main()
     vec3 ambient = 0.05 * color;
 
     // diffuse
-    vec3 lightDir = normalize(lightPos - fs_in.FragPos);
+    vec3 lightDir = normalize(pointLight[0].position - fs_in.FragPos);
     vec3 normal = normalize(fs_in.Normal);
     float diff = max(dot(lightDir, normal), 0.0);
     vec3 diffuse = diff * color;
 
     // specular
-    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
+    vec3 viewDir = normalize(viewPosition - fs_in.FragPos);
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = 0.0;
-    if(blinn) {
-        vec3 halfwayDir = normalize(lightDir + viewDir);
-        spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
-    } else {
-        vec3 reflectDir = reflect(-lightDir, normal);
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
-    }
+    // BLINN selects the Blinn-Phong variant, compiled as its own program
+#ifdef BLINN
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
+#else
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
+#endif
 
     vec3 specular = vec3(0.3) * spec;
     FragColor = vec4(ambient + diffuse + specular, 1.0);
+    BrightColor = vec4(0.0, 0.0, 0.0, FragColor.a);
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 sourceUvScale;     // part of source that holds the image
+uniform bool firstLevel;        // reading the full resolution bright color
+
+vec2 texel;
+
+vec3 tap(vec2 uv, vec2 offset)
+{
+    return texture(source, clamp(uv + offset * texel, 0.5 * texel, sourceUvScale - 0.5 * texel)).rgb;
+}
+
+// weights a group by its inverse luma, so a single very bright pixel can't flicker through the whole chain
+float karisWeight(vec3 color)
+{
+    return 1.0 / (1.0 + dot(color, vec3(0.2126, 0.7152, 0.0722)));
+}
+
+// 13 bilinear taps (36 texels) around the destination pixel, as four overlapping 2x2 boxes plus a center box
+void main()
+{
+    texel = 1.0 / vec2(textureSize(source, 0));
+    vec2 uv = TexCoords * sourceUvScale;
+
+    vec3 a = tap(uv, vec2(-2.0,  2.0)), b = tap(uv, vec2(0.0,  2.0)), c = tap(uv, vec2(2.0,  2.0));
+    vec3 d = tap(uv, vec2(-2.0,  0.0)), e = tap(uv, vec2(0.0,  0.0)), f = tap(uv, vec2(2.0,  0.0));
+    vec3 g = tap(uv, vec2(-2.0, -2.0)), h = tap(uv, vec2(0.0, -2.0)), i = tap(uv, vec2(2.0, -2.0));
+    vec3 j = tap(uv, vec2(-1.0,  1.0)), k = tap(uv, vec2(1.0,  1.0));
+    vec3 l = tap(uv, vec2(-1.0, -1.0)), m = tap(uv, vec2(1.0, -1.0));
+
+    vec3 center = (j + k + l + m) * 0.25;
+    vec3 topLeft = (a + b + d + e) * 0.25, topRight = (b + c + e + f) * 0.25;
+    vec3 bottomLeft = (d + e + g + h) * 0.25, bottomRight = (e + f + h + i) * 0.25;
+
+    vec3 color;
+    if(firstLevel) {
+        float wc = karisWeight(center) * 0.5;
+        float wtl = karisWeight(topLeft) * 0.125, wtr = karisWeight(topRight) * 0.125;
+        float wbl = karisWeight(bottomLeft) * 0.125, wbr = karisWeight(bottomRight) * 0.125;
+        color = (center * wc + topLeft * wtl + topRight * wtr + bottomLeft * wbl + bottomRight * wbr)
+              / (wc + wtl + wtr + wbl + wbr);
+    } else {
+        color = center * 0.5 + (topLeft + topRight + bottomLeft + bottomRight) * 0.125;
+    }
+    FragColor = vec4(color, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 sourceUvScale;     // part of source that holds the image
+uniform float radius;           // spread of the tent filter, in source texels
+
+vec2 texel;
+
+vec3 tap(vec2 uv, vec2 offset)
+{
+    return texture(source, clamp(uv + offset * texel * radius, 0.5 * texel, sourceUvScale - 0.5 * texel)).rgb;
+}
+
+// 3x3 tent filter over the next smaller level, added onto this one by the blend state
+void main()
+{
+    texel = 1.0 / vec2(textureSize(source, 0));
+    vec2 uv = TexCoords * sourceUvScale;
+
+    vec3 color = tap(uv, vec2(0.0, 0.0)) * 4.0;
+    color += (tap(uv, vec2(-1.0, 0.0)) + tap(uv, vec2(1.0, 0.0)) + tap(uv, vec2(0.0, -1.0)) + tap(uv, vec2(0.0, 1.0))) * 2.0;
+    color += tap(uv, vec2(-1.0, -1.0)) + tap(uv, vec2(1.0, -1.0)) + tap(uv, vec2(-1.0, 1.0)) + tap(uv, vec2(1.0, 1.0));
+    FragColor = vec4(color / 16.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#version 330 core
+
+// depth pre-pass: only depth is written, the vertex shader is the one of the shaded pass
+void main()
+{
+}
\ No newline at end of file
@@ -1,5 +1,6 @@
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
 
 in vec2 TexCoords;
 
@@ -8,4 +9,5 @@ uniform sampler2D texture1;
 void main()
 {
     FragColor = texture(texture1, TexCoords);
+    BrightColor = vec4(0.0, 0.0, 0.0, FragColor.a);
 }
\ No newline at end of file
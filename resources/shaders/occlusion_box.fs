@@ -0,0 +1,6 @@
+#version 330 core
+
+// only the depth test matters, color writes are masked off while the boxes are drawn
+void main()
+{
+}
\ No newline at end of file
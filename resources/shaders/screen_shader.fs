@@ -6,32 +6,33 @@ in vec2 TexCoords;
 uniform sampler2D scene;
 uniform sampler2D bloomBlur;
 
-uniform int effect;
+// variants: EFFECT 0 (blur), 1 (grayscale), 2 (edge detection) or 3 (tone mapping); HDR and BLOOM for the
+// latter. set by the application, which compiles a program per combination
+#ifndef EFFECT
+#define EFFECT 3
+#endif
+
 uniform float gamma;
-uniform bool hdr;
-uniform bool bloom;
 uniform float exposure;
+// part of the scene textures the scene was rendered into (dynamic resolution), the quad stretches it
+uniform vec2 uvScale;
+uniform vec2 bloomUvScale;
+uniform float bloomIntensity;
 
-const float offset = 1.0 / 300.0;
 vec3 col = vec3(0.0);
 vec3 sampleTex[9];
 
+// in texels of the scene texture
 vec2 offsets[9] = vec2[](
-    vec2(-offset,  offset), // top-left
-    vec2( 0.0f,    offset), // top-center
-    vec2( offset,  offset), // top-right
-    vec2(-offset,  0.0f),   // center-left
-    vec2( 0.0f,    0.0f),   // center-center
-    vec2( offset,  0.0f),   // center-right
-    vec2(-offset, -offset), // bottom-left
-    vec2( 0.0f,   -offset), // bottom-center
-    vec2( offset, -offset)  // bottom-right
-);
-
-float blurKernel[9] = float[](
-    1.0 / 16, 2.0 / 16, 1.0 / 16,
-    2.0 / 16, 4.0 / 16, 2.0 / 16,
-    1.0 / 16, 2.0 / 16, 1.0 / 16
+    vec2(-1.0,  1.0), // top-left
+    vec2( 0.0,  1.0), // top-center
+    vec2( 1.0,  1.0), // top-right
+    vec2(-1.0,  0.0), // center-left
+    vec2( 0.0,  0.0), // center-center
+    vec2( 1.0,  0.0), // center-right
+    vec2(-1.0, -1.0), // bottom-left
+    vec2( 0.0, -1.0), // bottom-center
+    vec2( 1.0, -1.0)  // bottom-right
 );
 
 float edgeDetectionKernel[9] = float[](
@@ -40,37 +41,40 @@ float edgeDetectionKernel[9] = float[](
     1.0, 1.0, 1.0
 );
 
+// kernel taps stay inside the rendered part, past it the texture holds stale pixels
+vec3 sceneTap(vec2 uv)
+{
+    vec2 halfTexel = 0.5 / vec2(textureSize(scene, 0));
+    return texture(scene, clamp(uv, halfTexel, uvScale - halfTexel)).rgb;
+}
+
 void main ()
 {
-    vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
-    vec3 hdrColor = texture(scene, TexCoords).rgb;
+    vec2 uv = TexCoords * uvScale;
+    vec3 hdrColor = texture(scene, uv).rgb;
 
-    if(effect == 0) {
-        for(int i = 0; i < 9; i++)
-            sampleTex[i] = vec3(texture(scene, TexCoords.st + offsets[i]));
-            col = vec3(0.0);
-                for(int i = 0; i < 9; i++)
-                    col += sampleTex[i] * blurKernel[i];
-        FragColor = vec4(col, 1.0);
-    } else if(effect == 1) {
-        FragColor = texture(scene, TexCoords);
-        float average = 0.2126 * FragColor.r + 0.7152 * FragColor.g + 0.0722 * FragColor.b;
-        FragColor = vec4(average, average, average, 1.0);
-    } else if(effect == 2) {
-        for(int i = 0; i < 9; i++)
-            sampleTex[i] = vec3(texture(scene, TexCoords.st + offsets[i]));
-            col = vec3(0.0);
-                for(int i = 0; i < 9; i++)
-                    col += sampleTex[i] * edgeDetectionKernel[i];
-        FragColor = vec4(col, 1.0);
-    } else if(effect == 3) {
-        if(hdr) {
-            if(bloom)
-                hdrColor += bloomColor;
-            vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
-            FragColor = vec4(pow(result, vec3(1.0 / gamma)), 1.0);
-        } else {
-            FragColor = vec4(hdrColor, 1.0);
-        }
-    }
+#if EFFECT == 0
+    // blurred by the separable filter passes before, scene is their result
+    FragColor = vec4(hdrColor, 1.0);
+#elif EFFECT == 1
+    FragColor = texture(scene, uv);
+    float average = 0.2126 * FragColor.r + 0.7152 * FragColor.g + 0.0722 * FragColor.b;
+    FragColor = vec4(average, average, average, 1.0);
+#elif EFFECT == 2
+    vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+    for(int i = 0; i < 9; i++)
+        sampleTex[i] = sceneTap(uv + offsets[i] * texel);
+    col = vec3(0.0);
+    for(int i = 0; i < 9; i++)
+        col += sampleTex[i] * edgeDetectionKernel[i];
+    FragColor = vec4(col, 1.0);
+#elif defined(HDR)
+#ifdef BLOOM
+    hdrColor += texture(bloomBlur, TexCoords * bloomUvScale).rgb * bloomIntensity;
+#endif
+    vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
+    FragColor = vec4(pow(result, vec3(1.0 / gamma)), 1.0);
+#else
+    FragColor = vec4(hdrColor, 1.0);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,34 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// FILTER_MAX_TAPS in separable_filter.h
+#define MAX_TAPS 17
+
+uniform sampler2D source;
+uniform vec2 sourceUvScale;     // part of source that holds the image
+uniform vec2 direction;         // (1, 0) for the horizontal pass, (0, 1) for the vertical one
+uniform int tapCount;
+uniform float offsets[MAX_TAPS];    // in texels, each tap is read on both sides of the center
+uniform float weights[MAX_TAPS];
+
+vec2 texel;
+
+vec3 tap(vec2 uv)
+{
+    return texture(source, clamp(uv, 0.5 * texel, sourceUvScale - 0.5 * texel)).rgb;
+}
+
+// one dimension of a separable kernel, two neighbouring texels per fetch through bilinear filtering
+void main()
+{
+    texel = 1.0 / vec2(textureSize(source, 0));
+    vec2 uv = TexCoords * sourceUvScale;
+    vec2 step = direction * texel;
+
+    vec3 color = tap(uv) * weights[0];
+    for(int i = 1; i < tapCount; i++)
+        color += (tap(uv + step * offsets[i]) + tap(uv - step * offsets[i])) * weights[i];
+    FragColor = vec4(color, 1.0);
+}
\ No newline at end of file
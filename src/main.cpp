@@ -9,10 +9,21 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <learnopengl/bloom.h>
 #include <learnopengl/filesystem.h>
+#include <learnopengl/frame_pacer.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_permutations.h>
 #include <learnopengl/camera.h>
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/gpu_timer.h>
 #include <learnopengl/model.h>
+#include <learnopengl/render_target.h>
+#include <learnopengl/resource_cache.h>
+#include <learnopengl/scene.h>
+#include <learnopengl/separable_filter.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/thread_pool.h>
 
 #include <iostream>
 
@@ -47,8 +58,8 @@ float pitch =  0.0f;
 float fov   =  45.0f;
 
 // Timing
-float deltaTime = 0.0f;
-float lastFrame = 0.0f;
+float deltaTime = 0.0f;     // smoothed, see FramePacer
+FramePacer framePacer;
 
 // Blinn-phong
 bool blinn = false;
@@ -81,9 +92,24 @@ struct ProgramState {
     PointLight pointLight;
     bool hdr = false;
     bool bloom = false;
+    float bloomThreshold = 1.0f;    // brightness where bloom starts
+    float bloomRadius = 1.0f;       // spread of the upsampling filter, in texels of each level
+    float bloomIntensity = 1.0f;
     float exposure = 0.2f;
     float gamma = 2.2f;
     int kernelEffects = 3;
+    int blurKernel = FILTER_GAUSSIAN;   // for the blur effect
+    int blurRadius = 4;                 // in texels
+    bool occlusionCulling = false;
+    bool depthPrepass = false;
+    int presentMode = PRESENT_VSYNC;
+    float targetFps = 60.0f;    // for PRESENT_LIMITED
+    bool dynamicResolution = false;
+    float gpuBudgetMs = 14.0f;  // GPU frame time the dynamic resolution scale aims for
+    RenderQueueStats renderStats;   // last frame's submit, not saved
+    float gpuFrameMs = 0.0f;        // latest GPU frame time and the render scale it led to, not saved
+    float renderScale = 1.0f;
+    BloomStats bloomStats;          // last measured bloom passes, not saved
     ProgramState() : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
 
     void SaveToFile(std::string filename);
@@ -165,6 +191,9 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    GLExtensions::Init((GLADloadproc) glfwGetProcAddress);
+    // Linked programs are saved here and loaded instead of compiled on the next launch
+    ProgramCache::Instance().SetDirectory("resources/shaders/cache");
 
     stbi_set_flip_vertically_on_load(true);
 
@@ -191,9 +220,28 @@ int main()
     glFrontFace(GL_CW);
 
     // Build and compile shaders
+    const ShaderDefines lightDefines = { "BROJ_POZICIONIH_SVETALA " + std::to_string(UNIFORM_POINT_LIGHTS) };
     Shader ourShader(
         "resources/shaders/2.model_lighting.vs", 
-        "resources/shaders/2.model_lighting.fs"
+        "resources/shaders/2.model_lighting.fs",
+        nullptr,
+        lightDefines
+    );
+    // same lighting, with the model matrix coming from a per-instance attribute
+    Shader ourInstancedShader(
+        "resources/shaders/2.model_lighting_instanced.vs", 
+        "resources/shaders/2.model_lighting.fs",
+        nullptr,
+        lightDefines
+    );
+    // depth-only variants of the two for the depth pre-pass
+    Shader ourDepthShader(
+        "resources/shaders/2.model_lighting.vs", 
+        "resources/shaders/depth_only.fs"
+    );
+    Shader ourInstancedDepthShader(
+        "resources/shaders/2.model_lighting_instanced.vs", 
+        "resources/shaders/depth_only.fs"
     );
     Shader skyboxShader(
         "resources/shaders/skybox.vs", 
@@ -207,27 +255,71 @@ int main()
         "resources/shaders/face_culling.vs", 
         "resources/shaders/face_culling.fs"
     );
-    Shader blinnPhongTextureShader(
+    // Phong and Blinn-Phong (B key) variants, compiled when first used
+    ShaderDefines blinnDefines = lightDefines;
+    blinnDefines.push_back("BLINN");
+    ShaderPermutations blinnPhongTextureShaders(
         "resources/shaders/blinn-phong_texture.vs", 
         "resources/shaders/blinn-phong_texture.fs"
     );
-    Shader screenShader(
+    // a variant per effect, HDR and bloom combination
+    ShaderPermutations screenShaders(
         "resources/shaders/screen_shader.vs", 
         "resources/shaders/screen_shader.fs"
     );
+    Shader bloomDownsampleShader(
+        "resources/shaders/bloom.vs",
+        "resources/shaders/bloom_downsample.fs"
+    );
+    Shader bloomUpsampleShader(
+        "resources/shaders/bloom.vs",
+        "resources/shaders/bloom_upsample.fs"
+    );
+    Shader separableFilterShader(
+        "resources/shaders/bloom.vs",
+        "resources/shaders/separable_filter.fs"
+    );
+    Shader occlusionBoxShader(
+        "resources/shaders/occlusion_box.vs", 
+        "resources/shaders/occlusion_box.fs"
+    );
 
-    // Load models
-    Model modelEarth("resources/objects/earth/Earth.obj");
+    // Load models (parsing and decoding on the worker threads, GPU upload here)
+    ThreadPool threadPool;
+    Model modelEarth, modelRocket, modelAstronaut, modelMars, modelSun;
+    // store only what the model shader reads, in its packed form
+    const VertexFormat modelFormat = VertexFormat::FromProgram(ourShader.ID);
+    for(Model *model : { &modelEarth, &modelRocket, &modelAstronaut, &modelMars, &modelSun })
+        model->SetVertexFormat(modelFormat);
+    // upload all meshes into shared buffers, so meshes of one vertex layout share a VAO and can be multi-drawn
+    GeometryArena::Instance().SetEnabled(true);
+    LoadModels({
+        { &modelEarth, "resources/objects/earth/Earth.obj" },
+        { &modelRocket, "resources/objects/rocket/Toy_Rocket.obj" },
+        { &modelAstronaut, "resources/objects/astronaut/Astronaut.obj" },
+        { &modelMars, "resources/objects/mars/Mars_2K.obj" },
+        { &modelSun, "resources/objects/sun/sun.obj" }
+    }, threadPool);
     modelEarth.SetShaderTextureNamePrefix("material.");
-    Model modelRocket("resources/objects/rocket/Toy_Rocket.obj");
     modelRocket.SetShaderTextureNamePrefix("material.");
-    Model modelAstronaut("resources/objects/astronaut/Astronaut.obj");
     modelAstronaut.SetShaderTextureNamePrefix("material.");
-    Model modelMars("resources/objects/mars/Mars_2K.obj");
     modelMars.SetShaderTextureNamePrefix("material.");
-    Model modelSun("resources/objects/sun/sun.obj");
     modelSun.SetShaderTextureNamePrefix(("material."));
 
+    // geometry only lives on the GPU unless a model asked to keep it (SetGeometryResidency)
+    const pair<const char*, const Model*> loadedModels[] = {
+        { "earth", &modelEarth }, { "rocket", &modelRocket }, { "astronaut", &modelAstronaut },
+        { "mars", &modelMars }, { "sun", &modelSun }
+    };
+    for(const pair<const char*, const Model*> &loaded : loadedModels)
+    {
+        GeometryMemory memory = loaded.second->MemoryUsage();
+        std::cout << "MODEL::MEMORY " << loaded.first << ": " << memory.cpuBytes << " bytes CPU, "
+                  << memory.gpuBytes << " bytes GPU" << std::endl;
+    }
+    std::cout << "MODEL::ARENA " << GeometryArena::Instance().PageCount() << " geometry pages, multi-draw indirect "
+              << (GLExtensions::MultiDrawElementsIndirect() ? "available" : "not available") << std::endl;
+
     // Skybox
     float skyboxVertices[] = {
         -1.0f,  1.0f, -1.0f,
@@ -429,62 +521,18 @@ int main()
     blendingShader.use();
     blendingShader.setInt("texture1", 0);
 
-    // HDR & Bloom
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for(unsigned int i = 0; i < 2; ++i) {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(
-            GL_TEXTURE_2D, 
-            0, 
-            GL_RGBA16F, 
-            SCR_WIDTH, 
-            SCR_HEIGHT, 
-            0, 
-            GL_RGBA, 
-            GL_FLOAT,
-            NULL
-        );
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(
-            GL_FRAMEBUFFER, 
-            GL_COLOR_ATTACHMENT0 + i, 
-            GL_TEXTURE_2D, 
-            colorBuffers[i], 
-            0
-        );
-    }
-
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(
-        GL_RENDERBUFFER, 
-        GL_DEPTH24_STENCIL8, 
-        SCR_WIDTH, 
-        SCR_HEIGHT
-    );
-    glFramebufferRenderbuffer(
-        GL_FRAMEBUFFER, 
-        GL_DEPTH_STENCIL_ATTACHMENT, 
-        GL_RENDERBUFFER, 
-        rboDepth
-    );
-
-    unsigned int attachments[2] = { 
-        GL_COLOR_ATTACHMENT0, 
-        GL_COLOR_ATTACHMENT1 
-    };
-    glDrawBuffers(2, attachments);
-    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cerr << "Framebuffer is not complete!" << "\n";
+    // HDR & Bloom: the scene renders into two floating point color targets, the second one getting the
+    // bright parts. they follow the window's framebuffer size and render at the dynamic resolution scale
+    RenderTargets renderTargets;
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    renderTargets.SetOutputSize(framebufferWidth, framebufferHeight);
+    RenderTarget &hdrTarget = renderTargets.Add({ GL_RGBA16F, GL_RGBA16F }, true);
+    // the bright part is blurred through a chain of half, quarter, ... resolution targets
+    Bloom bloom(renderTargets, bloomDownsampleShader, bloomUpsampleShader);
+    // the blur effect, two one-dimensional passes
+    SeparableFilter blurFilter(renderTargets, separableFilterShader);
+    GpuTimer gpuTimer;
 
     // Face culling
     float faceCullingBoxVertices[] = {
@@ -626,8 +674,6 @@ int main()
         FileSystem::getPath("resources/textures/metal_texture.png").c_str()
     );
 
-    blinnPhongTextureShader.use();
-    blinnPhongTextureShader.setInt("texture1", 0);
 
     PointLight& pointLight = programState->pointLight;
     pointLight.position = glm::vec3(-26.0f, 22.0f, 16.0f);
@@ -639,14 +685,65 @@ int main()
     pointLight.linear = 0.014f;
     pointLight.quadratic = 0.0007f;
 
+    // Everything placed in the world; transforms are only rebuilt when they change
+    const glm::vec3 yAxis(0.0f, 1.0f, 0.0f);
+    const glm::quat noRotation(1.0f, 0.0f, 0.0f, 0.0f);
+    Scene scene;
+    const Entity floorEntity = scene.Add(nullptr, glm::vec3(-5.0f, -0.55f, -2.0f));
+    const Entity blendingBoxEntity = scene.Add(nullptr, glm::vec3(-5.0f, 0.0f, -1.0f));
+    const Entity faceCullingBoxEntity = scene.Add(nullptr, glm::vec3(-5.0f, 0.0f, -3.0f));
+    // the small rocket and astronaut bob up and down inside the boxes; first, so they set the depth of their models
+    const Entity rocketMiniEntity = scene.Add(&modelRocket, glm::vec3(-5.0f, -0.4f, -1.0f), noRotation, glm::vec3(0.2f), true);
+    const Entity astronautMiniEntity = scene.Add(&modelAstronaut, glm::vec3(-5.0f, -0.4f, -3.0f),
+                                                 glm::angleAxis(glm::radians(90.0f), yAxis), glm::vec3(0.15f), true);
+    scene.Add(&modelSun, glm::vec3(-35.0f, 15.0f, 10.0f), noRotation, glm::vec3(9.5f));
+    scene.Add(&modelEarth, glm::vec3(0.0f, -5.0f, -25.0f),
+              glm::angleAxis(glm::radians(170.0f), glm::vec3(1.0f, 0.0f, 0.0f)) * glm::angleAxis(glm::radians(-40.0f), yAxis),
+              glm::vec3(4.5f));
+    scene.Add(&modelRocket, glm::vec3(8.0f, 1.9f, -20.0f),
+              glm::angleAxis(glm::radians(-50.0f), glm::vec3(0.0f, 0.0f, 1.0f)), glm::vec3(0.7f));
+    scene.Add(&modelMars, glm::vec3(35.0f, 8.0f, -15.0f), noRotation, glm::vec3(1.4f));
+    scene.Add(&modelAstronaut, glm::vec3(34.5f, 12.7f, -14.0f), glm::angleAxis(glm::radians(30.0f), yAxis), glm::vec3(0.15f));
+    scene.Add(&modelAstronaut, glm::vec3(34.9f, 12.7f, -14.0f), glm::angleAxis(glm::radians(-30.0f), yAxis), glm::vec3(0.15f));
+
+    // Camera, lights and frame data of all shaders, triple buffered
+    FrameUniforms frameUniforms;
+    for(Shader *modelShader : { &ourShader, &ourInstancedShader }) {
+        modelShader->use();
+        modelShader->setFloat("material.shininess", 32.0f);
+    }
+
+
+    // Every draw of the scene goes through here, sorted to keep program, texture and VAO switches down
+    RenderQueue renderQueue;
+    // models hidden behind the planets and boxes are skipped on the GPU using last frame's box queries
+    OcclusionQueries occlusionQueries(occlusionBoxShader);
+    renderQueue.SetOcclusionQueries(&occlusionQueries);
+    // the model lighting shader is the expensive one, an optional depth pre-pass lets it shade each pixel once
+    renderQueue.SetDepthPrepassShader(ourShader, ourDepthShader);
+    renderQueue.SetDepthPrepassShader(ourInstancedShader, ourInstancedDepthShader);
+
+    // Shader variants picked per frame, fetched from their permutations once and then reused: the floor by
+    // the B key, the screen pass by (effect, HDR, bloom) along with its uniforms
+    Shader *blinnPhongTextureVariants[2] = {};
+    struct ScreenProgram {
+        Shader *shader = nullptr;
+        UniformHandle exposure, gamma, uvScale, bloomUvScale, bloomIntensity;
+    };
+    ScreenProgram screenPrograms[4 * 2 * 2];
+
     // Render loop
     while(!glfwWindowShouldClose(window)) {
         float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        // Movement uses the smoothed frame time, so a single slow frame doesn't make the camera jump
+        framePacer.SetMode((PresentMode) programState->presentMode, programState->targetFps);
+        deltaTime = framePacer.BeginFrame();
 
         processInput(window);
 
+        // Stream in textures whose decoding finished since the last frame
+        TextureLoader::Instance().Update();
+
         glClearColor(
             programState->clearColor.r, 
             programState->clearColor.g, 
@@ -654,267 +751,171 @@ int main()
             1.0f
         );
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        ourShader.use();
-        ourShader.setBool("blinn", blinn);
-        ourShader.setVec3("viewPosition", programState->camera.Position);
+        // Follow the window size (reallocates only when it changed) and the GPU time of the last frames
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        renderTargets.SetOutputSize(framebufferWidth, framebufferHeight);
+        renderTargets.SetDynamicResolution(programState->dynamicResolution, programState->gpuBudgetMs);
+        if(gpuTimer.Poll())
+            renderTargets.UpdateScale(gpuTimer.Milliseconds());
+        programState->gpuFrameMs = gpuTimer.Milliseconds();
+        programState->renderScale = renderTargets.RenderScale();
+
+        gpuTimer.Begin();
+        hdrTarget.Bind();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // only what the lit models write goes into the bright color, the rest of it stays black
+        const float black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        glClearBufferfv(GL_COLOR, 1, black);
 
         glm::mat4 projection = glm::perspective(
             glm::radians(programState->camera.Zoom),
-            (float) SCR_WIDTH / (float) SCR_HEIGHT, 
+            (float) renderTargets.OutputWidth() / (float) renderTargets.OutputHeight(), 
             0.1f, 
             100.0f
         );
         glm::mat4 view = programState->camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-        // Metal texture under the box
-        blinnPhongTextureShader.use();
-        projection = glm::perspective(
-            glm::radians(programState->camera.Zoom), 
-            (float)SCR_WIDTH / (float)SCR_HEIGHT, 
-            0.1f, 
-            100.0f
-        );
-        view = programState->camera.GetViewMatrix();
-        blinnPhongTextureShader.setMat4("projection", projection);
-        blinnPhongTextureShader.setMat4("view", view);
 
-        blinnPhongTextureShader.setVec3("viewPos", programState->camera.Position);
-        blinnPhongTextureShader.setVec3("lightPos", pointLight.position);
-        blinnPhongTextureShader.setInt("blinn", blinn);
+        // Per-frame uniforms, written once into the shared uniform buffer every shader reads its camera,
+        // lights and frame data from; the render queue only sets the per-draw model matrix
+        frameUniforms.camera.projection = projection;
+        frameUniforms.camera.view = view;
+        frameUniforms.camera.viewPosition = programState->camera.Position;
 
-        glBindVertexArray(metalTextureVerticesVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, floorTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        // Directional light
+        frameUniforms.lights.dirLight.direction = glm::vec3(-30.0f, -50.0f, 0.0f);
+        frameUniforms.lights.dirLight.ambient = glm::vec3(0.06, 0.06, 0.06);
+        frameUniforms.lights.dirLight.diffuse = glm::vec3(0.6f, 0.2f, 0.2);
+        frameUniforms.lights.dirLight.specular = glm::vec3(0.1, 0.1, 0.1);
 
-        // Blending (rocket)
-        blendingShader.use();
-        projection = glm::perspective(
-            glm::radians(programState->camera.Zoom), 
-            (float)SCR_WIDTH / (float)SCR_HEIGHT,
-            0.1f, 
-            100.0f
-        );
-        view = programState->camera.GetViewMatrix();
-        glm::mat4 model = glm::mat4(1.0f);
-        blendingShader.setMat4("projection", projection);
-        blendingShader.setMat4("view", view);
+        // Light from the Sun
+        frameUniforms.lights.pointLight[0].position = pointLight.position;
+        frameUniforms.lights.pointLight[0].ambient = pointLight.ambient;
+        frameUniforms.lights.pointLight[0].diffuse = pointLight.diffuse;
+        frameUniforms.lights.pointLight[0].specular = pointLight.specular;
+        frameUniforms.lights.pointLight[0].constant = pointLight.constant;
+        frameUniforms.lights.pointLight[0].linear = pointLight.linear;
+        frameUniforms.lights.pointLight[0].quadratic = pointLight.quadratic;
+
+        frameUniforms.frame.time = currentFrame;
+        frameUniforms.frame.deltaTime = deltaTime;
+        frameUniforms.frame.bloomThreshold = programState->bloomThreshold;
+        frameUniforms.Upload();
+
+        // Record the frame; the queue draws opaque things front to back (grouped by program, textures and VAO),
+        // then the skybox, then transparent things back to front
+        renderQueue.SetDepthRange(0.1f, 100.0f);
+        renderQueue.SetFrustum(projection * view);
+        occlusionQueries.SetEnabled(programState->occlusionCulling);
+        renderQueue.EnableDepthPrepass(programState->depthPrepass);
+        occlusionQueries.BeginFrame(programState->camera.Position, 0.1f);
+
+        // Moving entities
+        const float bob = -0.1f * cos(currentFrame) - 0.3f;
+        scene.SetPosition(rocketMiniEntity, glm::vec3(-5.0f, bob, -1.0f));
+        scene.SetPosition(astronautMiniEntity, glm::vec3(-5.0f, bob, -3.0f));
+        scene.UpdateWorldMatrices();
+
+        // Metal texture under the box (its shader has no model matrix, the matrix only places it for sorting)
+        const glm::mat4 &floorMatrix = scene.World(floorEntity);
+        Shader *&blinnPhongTextureShader = blinnPhongTextureVariants[blinn];
+        if(!blinnPhongTextureShader)
+            blinnPhongTextureShader = &blinnPhongTextureShaders.Get(blinn ? blinnDefines : lightDefines);
+        renderQueue.AddArrays(PASS_OPAQUE, *blinnPhongTextureShader, metalTextureVerticesVAO, 0, 6,
+                              { { GL_TEXTURE_2D, floorTexture } }, floorMatrix, RenderQueue::ViewDepth(view, floorMatrix));
 
+        // Blending (rocket)
         // Non-transparent box side
-        glBindVertexArray(outsideTransparentVerticesVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, outsideTransparentTexture);
-        model = glm::translate(model, glm::vec3(-5.0f, 0.0f, -1.0f));
-        blendingShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 30);
-
-        glm::mat4 modelMatrixRocketMini= glm::mat4(1.0f);
-        modelMatrixRocketMini = glm::translate(
-            modelMatrixRocketMini, 
-            glm::vec3(-5.0f, -0.1f * cos(currentFrame) - 0.3f, -1.0f)
-        );
-        modelMatrixRocketMini = glm::scale(modelMatrixRocketMini, glm::vec3(0.2f));
-        ourShader.setMat4("model", modelMatrixRocketMini);
-        modelRocket.Draw(ourShader);
+        const glm::mat4 &blendingBoxMatrix = scene.World(blendingBoxEntity);
+        renderQueue.AddArrays(PASS_OPAQUE, blendingShader, outsideTransparentVerticesVAO, 0, 30,
+                              { { GL_TEXTURE_2D, outsideTransparentTexture } }, blendingBoxMatrix, RenderQueue::ViewDepth(view, blendingBoxMatrix));
 
         // Transparent box side
-        glBindVertexArray(transparentVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, transparentTexture);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-5.0f, 0.0f, -1.0f));
-        blendingShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        renderQueue.AddArrays(PASS_TRANSPARENT, blendingShader, transparentVAO, 0, 6,
+                              { { GL_TEXTURE_2D, transparentTexture } }, blendingBoxMatrix, RenderQueue::ViewDepth(view, blendingBoxMatrix));
 
         // Face culling (astronaut)
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_FRONT);
-        glFrontFace(GL_CW);
-        glBindVertexArray(faceCullingBoxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, faceCullingTexture);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-5.0f, 0.0f, -3.0f));
-        faceCullingShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glDisable(GL_CULL_FACE);
-
-        glm::mat4 modelMatrixAstronautMini= glm::mat4(1.0f);
-        modelMatrixAstronautMini = glm::translate(
-            modelMatrixAstronautMini, 
-            glm::vec3(-5.0f, -0.1f * cos(currentFrame) -0.3f, -3.0f)
-        );
-        modelMatrixAstronautMini = glm::rotate(
-            modelMatrixAstronautMini, 
-            glm::radians(90.0f), 
-            glm::vec3(0.0f, 1.0f, 0.0f)
-        );
-        modelMatrixAstronautMini = glm::scale(
-            modelMatrixAstronautMini, 
-            glm::vec3(0.15f)
-        );
-        ourShader.setMat4("model", modelMatrixAstronautMini);
-        modelAstronaut.Draw(ourShader);
-
-        ourShader.use();
-
-        // Directional light
-        ourShader.setVec3("dirLight.direction", -30.0f, -50.0f, 0.0f);
-        ourShader.setVec3("dirLight.ambient", 0.06, 0.06, 0.06);
-        ourShader.setVec3("dirLight.diffuse",  0.6f,0.2f,0.2);
-        ourShader.setVec3("dirLight.specular", 0.1, 0.1, 0.1);
-
-        // Light from the Sun
-        ourShader.setVec3("pointLight[0].position", pointLight.position);
-        ourShader.setVec3("pointLight[0].ambient", pointLight.ambient);
-        ourShader.setVec3("pointLight[0].diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLight[0].specular", pointLight.specular);
-        ourShader.setFloat("pointLight[0].constant", pointLight.constant);
-        ourShader.setFloat("pointLight[0].linear", pointLight.linear);
-        ourShader.setFloat("pointLight[0].quadratic", pointLight.quadratic);
-
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
-        projection = glm::perspective(
-            glm::radians(programState->camera.Zoom),
-            (float) SCR_WIDTH / (float) SCR_HEIGHT, 
-            0.1f, 
-            100.0f
-        );
-        view = programState->camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-
-        // Rendering models
-        // modelSun
-        glm::mat4 modelMatrixSun = glm::mat4(1.0f);
-        modelMatrixSun = glm::translate(
-            modelMatrixSun, 
-            glm::vec3(-35.0f, 15.0f, 10.0f)
-        );
-        modelMatrixSun = glm::scale(modelMatrixSun, glm::vec3(9.5f));
-        ourShader.setMat4("model", modelMatrixSun);
-        modelSun.Draw(ourShader);
-
-        // modelEarth
-        glm::mat4 modelMatrixEarth = glm::mat4(1.0f);
-        modelMatrixEarth = glm::translate(
-            modelMatrixEarth, 
-            glm::vec3(0.0f, -5.0f, -25.0f)
-        );
-        modelMatrixEarth = glm::rotate(
-            modelMatrixEarth, 
-            glm::radians(170.0f), 
-            glm::vec3(1.0f, 0.0f, 0.0f)
-        );
-        modelMatrixEarth = glm::rotate(
-            modelMatrixEarth, 
-            glm::radians(-40.0f), 
-            glm::vec3(0.0f, 1.0f, 0.0f)
-        );
-        modelMatrixEarth = glm::scale(modelMatrixEarth, glm::vec3(4.5f));
-        ourShader.setMat4("model", modelMatrixEarth);
-        modelEarth.Draw(ourShader);
-
-        // modelRocket
-        glm::mat4 modelMatrixRocket= glm::mat4(1.0f);
-        modelMatrixRocket = glm::translate(
-            modelMatrixRocket, 
-            glm::vec3(8.0f, 1.9f, -20.0f)
-        );
-        modelMatrixRocket = glm::rotate(
-            modelMatrixRocket, 
-            glm::radians(-50.0f), 
-            glm::vec3(0.0f, 0.0f, 1.0f)
-        );
-        modelMatrixRocket = glm::scale(modelMatrixRocket, glm::vec3(0.7f));
-        ourShader.setMat4("model", modelMatrixRocket);
-        modelRocket.Draw(ourShader);
-
-        // modelMars
-        glm::mat4 modelMatrixMars = glm::mat4(1.0f);
-        modelMatrixMars = glm::translate(
-            modelMatrixMars, 
-            glm::vec3(35.0f, 8.0f, -15.0f)
-        );
-        modelMatrixMars = glm::scale(modelMatrixMars, glm::vec3(1.4f));
-        ourShader.setMat4("model", modelMatrixMars);
-        modelMars.Draw(ourShader);
-
-        // modelAstronaut
-        glm::mat4 modelMatrixAstronaut = glm::mat4(1.0f);
-        modelMatrixAstronaut = glm::translate(
-            modelMatrixAstronaut, 
-            glm::vec3(34.5f, 12.7f, -14.0f)
-        );
-        modelMatrixAstronaut = glm::rotate(
-            modelMatrixAstronaut, 
-            glm::radians(30.0f), 
-            glm::vec3(0.0f, 1.0f, 0.0f)
-        );
-        modelMatrixAstronaut = glm::scale(
-            modelMatrixAstronaut, 
-            glm::vec3(0.15f)
-        );
-        ourShader.setMat4("model", modelMatrixAstronaut);
-        modelAstronaut.Draw(ourShader);
-
-        // modelAstronaut (second one)
-        glm::mat4 modelMatrixAstronaut2 = glm::mat4(1.0f);
-        modelMatrixAstronaut2 = glm::translate(
-            modelMatrixAstronaut2, 
-            glm::vec3(34.9f, 12.7f, -14.0f)
-        );
-        modelMatrixAstronaut2 = glm::rotate(
-            modelMatrixAstronaut2, 
-            glm::radians(-30.0f), 
-            glm::vec3(0.0f, 1.0f, 0.0f)
-        );
-        modelMatrixAstronaut2 = glm::scale(
-            modelMatrixAstronaut2, 
-            glm::vec3(0.15f)
-        );
-        ourShader.setMat4("model", modelMatrixAstronaut2);
-        modelAstronaut.Draw(ourShader);
-
-        // Skybox
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix()));
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS);
+        RenderState culled;
+        culled.cullFace = true;
+        const glm::mat4 &faceCullingBoxMatrix = scene.World(faceCullingBoxEntity);
+        renderQueue.AddArrays(PASS_OPAQUE, faceCullingShader, faceCullingBoxVAO, 0, 36,
+                              { { GL_TEXTURE_2D, faceCullingTexture } }, faceCullingBoxMatrix, RenderQueue::ViewDepth(view, faceCullingBoxMatrix), culled);
+
+        // Rendering models: models placed once are drawn normally, the rockets and the astronauts instanced,
+        // a single draw call per mesh for all their copies
+        scene.Enqueue(renderQueue, PASS_OPAQUE, ourShader, ourInstancedShader, view, projection, hdrTarget.ActiveHeight());
+
+        // Skybox, drawn after the opaque geometry where only uncovered pixels pass GL_LEQUAL
+        RenderState skyboxState;
+        skyboxState.depthFunc = GL_LEQUAL;
+        renderQueue.AddArrays(PASS_SKYBOX, skyboxShader, skyboxVAO, 0, 36,
+                              { { GL_TEXTURE_CUBE_MAP, cubemapTexture } }, glm::mat4(1.0f), 0.0f, skyboxState);
+
+        renderQueue.Submit();
+        programState->renderStats = renderQueue.stats;
+
+        const bool bloomEnabled = programState->hdr && programState->bloom && programState->kernelEffects == 3;
+        if(bloomEnabled) {
+            bloom.Render(hdrTarget.Color(1), hdrTarget.UvScale(), programState->bloomRadius);
+            programState->bloomStats = bloom.stats;
+        }
+        GLuint postTexture = hdrTarget.Color(0);
+        glm::vec2 postUvScale = hdrTarget.UvScale();
+        if(programState->kernelEffects == 0) {
+            blurFilter.SetKernel((FilterKernel) programState->blurKernel, programState->blurRadius);
+            blurFilter.Apply(hdrTarget.Color(0), hdrTarget.UvScale());
+            postTexture = blurFilter.Result();
+            postUvScale = blurFilter.UvScale();
+        }
 
+        // The screen pass covers the whole window and upscales the scene's part of the target
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, renderTargets.OutputWidth(), renderTargets.OutputHeight());
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Rendering quad-plane
+        // Rendering quad-plane with the variant specialized for the current settings; HDR only matters to tone mapping
+        const bool screenHdr = programState->kernelEffects == 3 && programState->hdr;
+        ScreenProgram &screenProgram = screenPrograms[(programState->kernelEffects * 2 + screenHdr) * 2 + bloomEnabled];
+        if(!screenProgram.shader) {
+            ShaderDefines screenDefines = { "EFFECT " + std::to_string(programState->kernelEffects) };
+            if(screenHdr)
+                screenDefines.push_back("HDR");
+            if(bloomEnabled)
+                screenDefines.push_back("BLOOM");
+            screenProgram.shader = &screenShaders.Get(screenDefines);
+            screenProgram.exposure = screenProgram.shader->Uniform("exposure");
+            screenProgram.gamma = screenProgram.shader->Uniform("gamma");
+            screenProgram.uvScale = screenProgram.shader->Uniform("uvScale");
+            screenProgram.bloomUvScale = screenProgram.shader->Uniform("bloomUvScale");
+            screenProgram.bloomIntensity = screenProgram.shader->Uniform("bloomIntensity");
+            screenProgram.shader->use();
+            screenProgram.shader->setInt("scene", 0);
+            screenProgram.shader->setInt("bloomBlur", 1);
+        }
+        Shader &screenShader = *screenProgram.shader;
         screenShader.use();
-        screenShader.setInt("bloom", programState->bloom);
-        screenShader.setInt("effect", programState->kernelEffects);
-        screenShader.setInt("hdr", programState->hdr);
-        screenShader.setFloat("exposure", programState->exposure);
-        screenShader.setFloat("gamma", programState->gamma);
+        screenShader.setFloat(screenProgram.exposure, programState->exposure);
+        screenShader.setFloat(screenProgram.gamma, programState->gamma);
+        screenShader.setVec2(screenProgram.uvScale, postUvScale);
+        screenShader.setVec2(screenProgram.bloomUvScale, bloom.UvScale());
+        screenShader.setFloat(screenProgram.bloomIntensity, programState->bloomIntensity);
 
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
+        glBindTexture(GL_TEXTURE_2D, postTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, bloom.Result());
+        glActiveTexture(GL_TEXTURE0);
 
         renderQuad();
+        gpuTimer.End();
 
         if(programState->ImGuiEnabled)
             DrawImGui(programState);
 
+        // The uniform slot of this frame can be reused once the GPU got past everything drawn so far
+        frameUniforms.EndFrame();
+
+        framePacer.Wait();
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
@@ -926,6 +927,8 @@ int main()
     ImGui::DestroyContext();
 
     // Terminate, clearing all previously allocated GLFW resources.
+    TextureCache::Instance().Shutdown();
+    TextureLoader::Instance().Shutdown();
     glDeleteVertexArrays(1, &skyboxVAO);
     glDeleteBuffers(1, &skyboxVBO);
     glDeleteVertexArrays(1, &outsideTransparentVerticesVAO);
@@ -937,6 +940,8 @@ int main()
     glDeleteVertexArrays(1, &metalTextureVerticesVAO);
     glDeleteBuffers(1, &metalTextureVerticesVBO);
 
+    // models and shaders are locals of main and outlive the context; their handles must not delete anymore
+    GLContextLifetime::End();
     glfwTerminate();
 
     return 0;
@@ -944,48 +949,9 @@ int main()
 
 unsigned int loadCubemap(vector<std::string> faces) 
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrComponents;
-    for (unsigned int i = 0; i < faces.size(); i++) {
-        unsigned char *data = stbi_load(
-            faces[i].c_str(), 
-            &width, 
-            &height, 
-            &nrComponents, 
-            0
-        );
-
-        if(data) {
-            glTexImage2D(
-                GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 
-                0, 
-                GL_RGB, 
-                width, 
-                height, 
-                0, 
-                GL_RGB, 
-                GL_UNSIGNED_BYTE, 
-                data
-            );
-            stbi_image_free(data);
-        } else {
-            std::cout << 
-                "Cubemap texture failed to load at path: " << 
-                faces[i] << 
-                std::endl;
-            stbi_image_free(data);
-        }
-    }
-
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    return textureID;
+    // Shared through the texture cache and decoded in the background,
+    // the placeholder is replaced once all six faces are uploaded
+    return TextureCache::Instance().AcquireCubemap(faces);
 }
 
 void processInput(GLFWwindow *window) 
@@ -1063,6 +1029,36 @@ void DrawImGui(ProgramState *programState)
         ImGui::Begin("Settings");
         ImGui::Text("Scene settings");
 
+        ImGui::Checkbox("Occlusion culling", &programState->occlusionCulling);
+        ImGui::Checkbox("Depth pre-pass", &programState->depthPrepass);
+        ImGui::Checkbox("Dynamic resolution", &programState->dynamicResolution);
+        if (programState->dynamicResolution) {
+            ImGui::DragFloat("GPU budget (ms)", &programState->gpuBudgetMs, 0.1f, 2.0f, 50.0f);
+        }
+
+        ImGui::Text("Frame pacing");
+        ImGui::Combo("Presentation", &programState->presentMode, PRESENT_MODE_NAMES, PRESENT_MODE_COUNT);
+        if (programState->presentMode == PRESENT_LIMITED) {
+            ImGui::DragFloat("Target FPS", &programState->targetFps, 1.0f, 10.0f, 500.0f);
+        }
+        float frameTimeMean, frameTimeVariance;
+        framePacer.Statistics(frameTimeMean, frameTimeVariance);
+        char frameTimeOverlay[64];
+        snprintf(frameTimeOverlay, sizeof(frameTimeOverlay), "mean %.2f ms, variance %.3f", frameTimeMean, frameTimeVariance);
+        ImGui::PlotLines(
+            "Frame time (ms)",
+            framePacer.History(), framePacer.HistorySize(), framePacer.HistoryOffset(),
+            frameTimeOverlay, 0.0f, 2.0f * frameTimeMean + 1.0f, ImVec2(0.0f, 60.0f)
+        );
+
+        ImGui::Text("Post-processing");
+        const char *const effectNames[] = { "Blur", "Grayscale", "Edge detection", "Tone mapping" };
+        ImGui::Combo("Effect", &programState->kernelEffects, effectNames, 4);
+        if (programState->kernelEffects == 0) {
+            ImGui::Combo("Blur kernel", &programState->blurKernel, FILTER_KERNEL_NAMES, FILTER_KERNEL_COUNT);
+            ImGui::SliderInt("Blur radius", &programState->blurRadius, 1, FILTER_MAX_RADIUS);
+        }
+
         ImGui::Text("Hdr/Bloom");
         ImGui::Checkbox("HDR", &programState->hdr);
         if (programState->hdr) {
@@ -1070,6 +1066,19 @@ void DrawImGui(ProgramState *programState)
                 "Bloom", 
                 &programState->bloom
             );
+            if (programState->bloom) {
+                ImGui::DragFloat("Bloom threshold", &programState->bloomThreshold, 0.05f, 0.0f, 10.0f);
+                ImGui::DragFloat("Bloom radius", &programState->bloomRadius, 0.05f, 0.5f, 3.0f);
+                ImGui::DragFloat("Bloom intensity", &programState->bloomIntensity, 0.05f, 0.0f, 5.0f);
+                const BloomStats &bloomStats = programState->bloomStats;
+                ImGui::Text("Bloom GPU time: %.3f ms", bloomStats.totalMs);
+                for (unsigned int level = 0; level < BLOOM_LEVELS; level++) {
+                    ImGui::Text(
+                        "  level %u: down %.3f ms, up %.3f ms",
+                        level, bloomStats.downsampleMs[level], bloomStats.upsampleMs[level]
+                    );
+                }
+            }
             ImGui::DragFloat(
                 "Exposure", 
                 &programState->exposure, 
@@ -1125,6 +1134,18 @@ void DrawImGui(ProgramState *programState)
             "Camera mouse update", 
             &programState->CameraMouseMovementUpdateEnabled
         );
+        ImGui::Text(
+            "Meshes drawn/culled: %u/%u",
+            programState->renderStats.drawnMeshes, programState->renderStats.culledMeshes
+        );
+        ImGui::Text(
+            "Occlusion queries/conditional draws: %u/%u",
+            programState->renderStats.occlusionQueries, programState->renderStats.conditionalDraws
+        );
+        ImGui::Text(
+            "GPU frame time: %.2f ms, render scale %.2f",
+            programState->gpuFrameMs, programState->renderScale
+        );
         ImGui::End();
     }
 
@@ -1153,62 +1174,9 @@ void key_callback(
 
 unsigned int loadTexture(char const * path)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if(data) {
-        GLenum format;
-        if(nrComponents == 1)
-            format = GL_RED;
-        else if(nrComponents == 3)
-            format = GL_RGB;
-        else if(nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(
-            GL_TEXTURE_2D, 
-            0, 
-            format, 
-            width, 
-            height, 
-            0, 
-            format, 
-            GL_UNSIGNED_BYTE, 
-            data
-        );
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(
-            GL_TEXTURE_2D, 
-            GL_TEXTURE_WRAP_S, 
-            format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT
-        );
-        glTexParameteri(
-            GL_TEXTURE_2D, 
-            GL_TEXTURE_WRAP_T, 
-            format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT
-        );
-        glTexParameteri(
-            GL_TEXTURE_2D, 
-            GL_TEXTURE_MIN_FILTER, 
-            GL_LINEAR_MIPMAP_LINEAR
-        );
-        glTexParameteri(
-            GL_TEXTURE_2D, 
-            GL_TEXTURE_MAG_FILTER, 
-            GL_LINEAR
-        );
-
-        stbi_image_free(data);
-    } else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    // Transparent textures are clamped so their borders don't bleed, everything else repeats.
+    // Loading the same file twice hands out the same texture.
+    return TextureCache::Instance().Acquire2D(path, true);
 }
 
 unsigned int quadVAO = 0;
@@ -0,0 +1,267 @@
+// Offline texture baker: converts images into BC1/BC3 compressed DDS files with a full mip chain.
+//
+//   texture_baker <image> [<image> ...]
+//
+// every input is written next to itself with a .dds extension. images with an alpha channel become BC3 (DXT5),
+// everything else BC1 (DXT1). the TextureLoader picks up the .dds instead of the source image when it is newer.
+// rows are flipped on load exactly like the renderer does (stbi_set_flip_vertically_on_load(true) in main).
+
+#include <stb_image.h>
+
+#include <learnopengl/dds.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+using namespace std;
+
+struct RGBA {
+    unsigned char r, g, b, a;
+};
+
+// 2x2 box filter down to the next mip level, odd edges reuse the last row/column
+static vector<RGBA> downsample(const vector<RGBA> &src, int width, int height, int &outWidth, int &outHeight)
+{
+    outWidth = max(width / 2, 1);
+    outHeight = max(height / 2, 1);
+    vector<RGBA> dst((size_t)outWidth * outHeight);
+    for(int y = 0; y < outHeight; y++)
+    {
+        for(int x = 0; x < outWidth; x++)
+        {
+            int x0 = min(2 * x, width - 1), x1 = min(2 * x + 1, width - 1);
+            int y0 = min(2 * y, height - 1), y1 = min(2 * y + 1, height - 1);
+            const RGBA *p[4] = { &src[(size_t)y0 * width + x0], &src[(size_t)y0 * width + x1],
+                                 &src[(size_t)y1 * width + x0], &src[(size_t)y1 * width + x1] };
+            RGBA &out = dst[(size_t)y * outWidth + x];
+            out.r = (unsigned char)((p[0]->r + p[1]->r + p[2]->r + p[3]->r + 2) / 4);
+            out.g = (unsigned char)((p[0]->g + p[1]->g + p[2]->g + p[3]->g + 2) / 4);
+            out.b = (unsigned char)((p[0]->b + p[1]->b + p[2]->b + p[3]->b + 2) / 4);
+            out.a = (unsigned char)((p[0]->a + p[1]->a + p[2]->a + p[3]->a + 2) / 4);
+        }
+    }
+    return dst;
+}
+
+static unsigned short to565(float r, float g, float b)
+{
+    int ri = (int)lround(min(max(r, 0.0f), 255.0f) * 31.0f / 255.0f);
+    int gi = (int)lround(min(max(g, 0.0f), 255.0f) * 63.0f / 255.0f);
+    int bi = (int)lround(min(max(b, 0.0f), 255.0f) * 31.0f / 255.0f);
+    return (unsigned short)((ri << 11) | (gi << 5) | bi);
+}
+
+static void from565(unsigned short c, float out[3])
+{
+    out[0] = (float)((c >> 11) & 31) * 255.0f / 31.0f;
+    out[1] = (float)((c >> 5) & 63) * 255.0f / 63.0f;
+    out[2] = (float)(c & 31) * 255.0f / 31.0f;
+}
+
+// BC1 color block: endpoints on the principal axis of the block colors, 4-color mode
+static void encodeColorBlock(const RGBA block[16], unsigned char out[8])
+{
+    float mean[3] = {0, 0, 0};
+    for(int i = 0; i < 16; i++)
+    {
+        mean[0] += block[i].r;
+        mean[1] += block[i].g;
+        mean[2] += block[i].b;
+    }
+    for(int c = 0; c < 3; c++)
+        mean[c] /= 16.0f;
+
+    float cov[6] = {0, 0, 0, 0, 0, 0};
+    for(int i = 0; i < 16; i++)
+    {
+        float d[3] = { block[i].r - mean[0], block[i].g - mean[1], block[i].b - mean[2] };
+        cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+    }
+    // a few power iterations are plenty for a 3x3 covariance matrix
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for(int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[3] = {
+            cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]
+        };
+        float length = sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if(length < 1e-6f)
+            break;
+        for(int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+
+    float minProj = 1e30f, maxProj = -1e30f;
+    for(int i = 0; i < 16; i++)
+    {
+        float proj = (block[i].r - mean[0]) * axis[0] + (block[i].g - mean[1]) * axis[1] + (block[i].b - mean[2]) * axis[2];
+        minProj = min(minProj, proj);
+        maxProj = max(maxProj, proj);
+    }
+    unsigned short c0 = to565(mean[0] + axis[0] * maxProj, mean[1] + axis[1] * maxProj, mean[2] + axis[2] * maxProj);
+    unsigned short c1 = to565(mean[0] + axis[0] * minProj, mean[1] + axis[1] * minProj, mean[2] + axis[2] * minProj);
+    if(c0 < c1)
+        swap(c0, c1);
+
+    unsigned int indices = 0;
+    if(c0 != c1)
+    {
+        float palette[4][3];
+        from565(c0, palette[0]);
+        from565(c1, palette[1]);
+        for(int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+        for(int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            float bestError = 1e30f;
+            for(int p = 0; p < 4; p++)
+            {
+                float dr = block[i].r - palette[p][0], dg = block[i].g - palette[p][1], db = block[i].b - palette[p][2];
+                float error = dr * dr + dg * dg + db * db;
+                if(error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (unsigned int)best << (2 * i);
+        }
+    }
+    out[0] = (unsigned char)(c0 & 0xFF); out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)(c1 & 0xFF); out[3] = (unsigned char)(c1 >> 8);
+    for(int i = 0; i < 4; i++)
+        out[4 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+// BC3 alpha block: min/max endpoints, 8 interpolated values
+static void encodeAlphaBlock(const RGBA block[16], unsigned char out[8])
+{
+    unsigned char a0 = 0, a1 = 255;
+    for(int i = 0; i < 16; i++)
+    {
+        a0 = max(a0, block[i].a);
+        a1 = min(a1, block[i].a);
+    }
+    out[0] = a0;
+    out[1] = a1;
+    unsigned long long indices = 0;
+    if(a0 != a1)
+    {
+        float palette[8];
+        palette[0] = a0;
+        palette[1] = a1;
+        for(int p = 1; p < 7; p++)
+            palette[p + 1] = ((7 - p) * a0 + p * a1) / 7.0f;
+        for(int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            float bestError = 1e30f;
+            for(int p = 0; p < 8; p++)
+            {
+                float error = fabs(block[i].a - palette[p]);
+                if(error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (unsigned long long)best << (3 * i);
+        }
+    }
+    for(int i = 0; i < 6; i++)
+        out[2 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+static void compressLevel(const vector<RGBA> &pixels, int width, int height, unsigned int format, unsigned char *out)
+{
+    const size_t blockSize = DDSBlockSize(format);
+    for(int by = 0; by < (height + 3) / 4; by++)
+    {
+        for(int bx = 0; bx < (width + 3) / 4; bx++)
+        {
+            // partial blocks at the edges repeat the last row/column
+            RGBA block[16];
+            for(int y = 0; y < 4; y++)
+                for(int x = 0; x < 4; x++)
+                    block[y * 4 + x] = pixels[(size_t)min(by * 4 + y, height - 1) * width + min(bx * 4 + x, width - 1)];
+
+            if(format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+            {
+                encodeAlphaBlock(block, out);
+                encodeColorBlock(block, out + 8);
+            }
+            else
+            {
+                encodeColorBlock(block, out);
+            }
+            out += blockSize;
+        }
+    }
+}
+
+static bool bake(const string &path)
+{
+    int width, height, nrComponents;
+    unsigned char *data = stbi_load(path.c_str(), &width, &height, &nrComponents, 4);
+    if(!data)
+    {
+        printf("failed to load %s: %s\n", path.c_str(), stbi_failure_reason());
+        return false;
+    }
+    vector<RGBA> pixels((RGBA*)data, (RGBA*)data + (size_t)width * height);
+    stbi_image_free(data);
+
+    // only spend the extra 8 bytes per block on alpha if the image actually has some
+    bool hasAlpha = false;
+    if(nrComponents == 2 || nrComponents == 4)
+    {
+        for(const RGBA &pixel : pixels)
+            hasAlpha = hasAlpha || pixel.a != 255;
+    }
+
+    DDSImage image;
+    image.format = hasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    for(;;)
+    {
+        DDSLevel level = { image.data.size(), DDSLevelSize(image.format, width, height), width, height };
+        image.levels.push_back(level);
+        image.data.resize(level.offset + level.size);
+        compressLevel(pixels, width, height, image.format, image.data.data() + level.offset);
+        if(width == 1 && height == 1)
+            break;
+        pixels = downsample(pixels, width, height, width, height);
+    }
+
+    string output = path.substr(0, path.find_last_of('.')) + ".dds";
+    if(!WriteDDS(output, image))
+    {
+        printf("failed to write %s\n", output.c_str());
+        return false;
+    }
+    printf("%s -> %s (%s, %d levels, %zu bytes)\n", path.c_str(), output.c_str(),
+           hasAlpha ? "BC3" : "BC1", (int)image.levels.size(), image.data.size());
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 2)
+    {
+        printf("usage: %s <image> [<image> ...]\n", argv[0]);
+        return 1;
+    }
+    stbi_set_flip_vertically_on_load(true);
+    int failed = 0;
+    for(int i = 1; i < argc; i++)
+        failed += bake(argv[i]) ? 0 : 1;
+    return failed == 0 ? 0 : 1;
+}